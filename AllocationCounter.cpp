@@ -0,0 +1,78 @@
+//
+// Counts the heap allocations of the process in debug builds, to check that per-frame code does not allocate.
+//
+
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <opencv2/core.hpp>
+
+#if CLIMBPM_COUNT_ALLOCATIONS
+
+// Process-wide, a thread local counter would miss what parallel_for_() hands to its worker threads
+static std::atomic<uint64_t> allocations(0);
+
+// Mat buffers are allocated by OpenCV without operator new, so they are counted by the default Mat allocator
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        // Mats wrapping existing memory do not allocate
+        if (data == nullptr) allocations.fetch_add(1, std::memory_order_relaxed);
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+    // Buffers remember the standard allocator as theirs, so they are released without passing here
+    void deallocate(cv::UMatData* data) const override {
+        cv::Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+static CountingMatAllocator countingMatAllocator;
+
+// Installed before main() runs
+static struct CountingMatAllocatorInstaller {
+    CountingMatAllocatorInstaller() { cv::Mat::setDefaultAllocator(&countingMatAllocator); }
+} countingMatAllocatorInstaller;
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+uint64_t AllocationCounter::count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t AllocationCounter::count() {
+    return 0;
+}
+
+#endif
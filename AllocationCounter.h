@@ -0,0 +1,26 @@
+//
+// Counts the heap allocations of the process in debug builds, to check that per-frame code does not allocate.
+//
+
+#ifndef CLIMBPM_ALLOCATIONCOUNTER_H
+#define CLIMBPM_ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+#ifndef NDEBUG
+#define CLIMBPM_COUNT_ALLOCATIONS 1
+#else
+#define CLIMBPM_COUNT_ALLOCATIONS 0
+#endif
+
+class AllocationCounter {
+public:
+    // Whether allocations are counted at all
+    static constexpr bool enabled() { return CLIMBPM_COUNT_ALLOCATIONS != 0; }
+    // Number of operator new calls and Mat buffer allocations of all threads so far (0 in release builds).
+    // Includes the worker threads of parallel_for_(), but also whatever other threads allocate meanwhile.
+    static uint64_t count();
+};
+
+
+#endif //CLIMBPM_ALLOCATIONCOUNTER_H
@@ -0,0 +1,59 @@
+//
+// Writes images to disk on background threads.
+//
+
+#include "AsyncImageWriter.h"
+#include <algorithm>
+#include <iostream>
+#include <opencv2/imgcodecs.hpp>
+
+AsyncImageWriter::AsyncImageWriter(uint threadCount, size_t capacity) : queue(capacity), pending(0) {
+    for (uint i = 0; i < std::max(threadCount, 1u); i++)
+        workers.emplace_back(&AsyncImageWriter::work, this);
+}
+
+AsyncImageWriter::~AsyncImageWriter() {
+    // Remaining images are still written before the workers exit
+    queue.close();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void AsyncImageWriter::write(const std::string& path, Mat&& image) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        pending++;
+    }
+    queue.push(Job{ path, std::move(image) });
+}
+
+bool AsyncImageWriter::flush() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    idle.wait(lock, [this] { return pending == 0; });
+
+    if (failed.empty()) return true;
+    std::cerr << "Error saving " << failed.size() << " image(s):" << std::endl;
+    for (const auto& path : failed)
+        std::cerr << "\t" << path << std::endl;
+    failed.clear();
+    return false;
+}
+
+void AsyncImageWriter::work() {
+    Job job;
+    while (queue.pop(job)) {
+        bool success = false;
+        try {
+            success = imwrite(job.path, job.image);
+        }
+        catch (const Exception& e) {
+            std::cerr << "Exception while saving \"" << job.path << "\": " << e.what() << std::endl;
+        }
+        // Release the image before reporting, the caller may wait for memory to be freed
+        job.image.release();
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!success) failed.push_back(job.path);
+        if (--pending == 0) idle.notify_all();
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Writes images to disk on background threads.
+//
+
+#ifndef CLIMBPM_ASYNCIMAGEWRITER_H
+#define CLIMBPM_ASYNCIMAGEWRITER_H
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "BoundedQueue.h"
+
+using namespace cv;
+
+class AsyncImageWriter {
+public:
+    // Encodes and writes up to threadCount images in parallel, write() blocks once capacity images are queued
+    explicit AsyncImageWriter(uint threadCount = 2, size_t capacity = 8);
+    ~AsyncImageWriter();
+    AsyncImageWriter(const AsyncImageWriter&) = delete;
+    AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+    // Queues the image for writing, the caller's Mat header is moved (the pixel data is not copied)
+    void write(const std::string& path, Mat&& image);
+    // Waits until all queued images are written, reports failed writes and returns false if there were any
+    bool flush();
+
+private:
+    struct Job {
+        std::string path;
+        Mat image;
+    };
+
+    BoundedQueue<Job> queue;
+    std::vector<std::thread> workers;
+    // Queued but not yet written jobs and paths that could not be written since the last flush
+    std::mutex stateMutex;
+    std::condition_variable idle;
+    size_t pending;
+    std::vector<std::string> failed;
+
+    void work();
+};
+
+
+#endif //CLIMBPM_ASYNCIMAGEWRITER_H
@@ -0,0 +1,257 @@
+//
+// Headless benchmark of the calibration and warping stages (ClimbPM_bench).
+// Runs on copies of the example captures and writes the timings (and the pyramid decode's deviation from the full decode) as JSON:
+//   ClimbPM_bench [--fixtures <dir with captured1..3>] [--iterations <n>] [--output <file.json>]
+//
+
+#include "ProjectorConfig.h"
+#include <functional>
+
+#define BENCH_PROJECTOR_COUNT 3
+
+// Resolution of the projectors the example captures were taken with: captured3 holds 42 patterns, i.e.
+// 11 column and 10 row bits, and its coarsest column pattern splits the footprint at a quarter of 1366
+static const Size benchProjectorResolutions[BENCH_PROJECTOR_COUNT] = { Size(1920, 1080), Size(1920, 1080), Size(1366, 768) };
+
+struct BenchResult {
+    std::string stage;
+    // 0 for stages covering all projectors
+    int projector;
+    std::vector<double> timesMs;
+};
+
+// C2P map of the pyramid decode compared to the full decode
+struct DecodeAccuracy {
+    int projector;
+    // Camera pixels mapped by both decodes and mapped by only one of them
+    int comparedPixels;
+    int validMismatch;
+    // Distance between the projector pixels of both decodes (projector pixels)
+    double errorMean, errorP99, errorMax;
+};
+
+class Benchmark {
+public:
+    Benchmark(const fs::path& fixtures, int iterations) : fixtures(fixtures), iterations(iterations) {}
+
+    bool run() {
+        if (!prepareWorkingDirectory()) return false;
+
+        // Same setup as main(), but without windows
+        Mat firstWhite = imread("captured1/cam_00.png", IMREAD_GRAYSCALE);
+        if (firstWhite.empty()) {
+            std::cerr << "No captures found in \"" << fixtures.string() << "\"!" << std::endl;
+            return false;
+        }
+        ProjectorConfig::CAMWIDTH = firstWhite.cols;
+        ProjectorConfig::CAMHEIGHT = firstWhite.rows;
+        for (int i = 0; i < BENCH_PROJECTOR_COUNT; i++) {
+            const Size& resolution = benchProjectorResolutions[i];
+            projectors[i] = ProjectorConfig(ProjectorParams(i + 1, resolution.width, resolution.height, 0, 0));
+        }
+
+        // Stages in calibration order, each one prepares what the next one needs
+        for (int i = 0; i < BENCH_PROJECTOR_COUNT; i++) {
+            ProjectorConfig& projector = projectors[i];
+            measure("loadGraycodes", i + 1, [&] { projector.loadGraycodes(); });
+            // White and black are captured in addition to the patterns
+            size_t expectedImages = GraycodeDecoder(projector.params.width, projector.params.height, WHITETHRESHOLD).getImageCount() + 2;
+            if (projector.captured.size() != expectedImages) {
+                std::cerr << "Projector " << i + 1 << " has " << projector.captured.size() << " captures, but a "
+                          << projector.params.width << " x " << projector.params.height << " projector needs "
+                          << expectedImages << "!" << std::endl;
+                return false;
+            }
+            // Decoding consumes the captures (white and black are taken out, the rest is corrected in place)
+            std::vector<Mat> loaded = projector.captured;
+            auto restoreCaptures = [&] {
+                projector.captured.clear();
+                for (const Mat& image : loaded) projector.captured.push_back(image.clone());
+            };
+            // The full decode runs last, so the following stages work on its result
+            measure("decodeGraycodePyramid", i + 1, [&] { projector.decodeGraycode(DECODE_PYRAMID); }, restoreCaptures);
+            Mat pyramidMap = projector.c2pMap.clone(), pyramidValid = projector.c2pValid.clone();
+            // OpenCV's per-pixel decode needs the pattern object generateGraycodes() creates
+            projector.generateGraycodes();
+            measure("decodeGraycodeOpenCV", i + 1, [&] { projector.decodeGraycode(DECODE_OPENCV); }, restoreCaptures);
+            measure("decodeGraycode", i + 1, [&] { projector.decodeGraycode(); }, restoreCaptures);
+            if (projector.c2pValid.empty()) {
+                std::cerr << "Decoding projector " << i + 1 << " failed!" << std::endl;
+                return false;
+            }
+            accuracy.push_back(compareDecodes(i + 1, pyramidMap, pyramidValid, projector.c2pMap, projector.c2pValid));
+            Mat viz = projector.c2pVisualization();
+            measure("reduceCalibrationNoise", i + 1, [&] { projector.reduceCalibrationNoise(viz); });
+            // Legacy path the binary file replaced: CSV import and conversion, as on the first launch without c2p.bin
+            Mat decodedMap = projector.c2pMap.clone(), decodedValid = projector.c2pValid.clone();
+            projector.exportC2Plist();
+            std::string c2pBinary = "captured" + std::to_string(i + 1) + "/c2p.bin";
+            measure("loadC2PlistCSV", i + 1, [&] { projector.loadC2Plist(); }, [&] { fs::remove(c2pBinary); });
+            // The CSV drops pixels mapped to (0, 0), the following stages work on the decoded map again
+            projector.c2pMap = decodedMap;
+            projector.c2pValid = decodedValid;
+            projector.saveC2Plist();
+            measure("loadC2Plist", i + 1, [&] { projector.loadC2Plist(); });
+            measure("computeHomography", i + 1, [&] { projector.computeHomography(); });
+        }
+        measure("computeContributions", 0, [&] { ProjectorConfig::computeContributions(projectors, BENCH_PROJECTOR_COUNT); });
+
+        // Fixed content, so runs are comparable; the first iteration includes building the warp maps
+        Mat content(ProjectorConfig::CAMHEIGHT, ProjectorConfig::CAMWIDTH, CV_8UC3);
+        randu(content, Scalar::all(0), Scalar::all(256));
+        for (int i = 0; i < BENCH_PROJECTOR_COUNT; i++) {
+            ProjectorConfig& projector = projectors[i];
+            Mat warped;
+            measure("warpImage", i + 1, [&] { projector.warpImage(content, warped); });
+            projector.setWarpMode(WARP_REMAP);
+            measure("warpImageRemap", i + 1, [&] { projector.warpImage(content, warped); });
+            projector.setWarpMode(WARP_HOMOGRAPHY);
+            measure("applyAreaMask", i + 1, [&] { projector.applyAreaMask(false); });
+        }
+        return true;
+    }
+
+    bool writeJSON(std::ostream& os) const {
+        os << "{\n"
+           << "  \"benchmark\": \"ClimbPM_bench\",\n"
+           << "  \"opencv\": \"" << CV_VERSION << "\",\n"
+           << "  \"threads\": " << getNumThreads() << ",\n"
+           << "  \"camera\": [" << ProjectorConfig::CAMWIDTH << ", " << ProjectorConfig::CAMHEIGHT << "],\n"
+           << "  \"projectors\": [";
+        for (int i = 0; i < BENCH_PROJECTOR_COUNT; i++)
+            os << (i > 0 ? ", " : "") << "[" << benchProjectorResolutions[i].width << ", " << benchProjectorResolutions[i].height << "]";
+        os << "],\n"
+           << "  \"iterations\": " << iterations << ",\n"
+           << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& result = results[i];
+            std::vector<double> sorted = result.timesMs;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (double ms : sorted) total += ms;
+            os << "    { \"stage\": \"" << result.stage << "\", \"projector\": " << result.projector
+               << ", \"firstMs\": " << result.timesMs.front()
+               << ", \"minMs\": " << sorted.front()
+               << ", \"medianMs\": " << sorted[sorted.size() / 2]
+               << ", \"meanMs\": " << total / sorted.size()
+               << ", \"maxMs\": " << sorted.back() << " }"
+               << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        os << "  ],\n"
+           << "  \"pyramidAccuracy\": [\n";
+        for (size_t i = 0; i < accuracy.size(); i++) {
+            const DecodeAccuracy& a = accuracy[i];
+            os << "    { \"projector\": " << a.projector
+               << ", \"comparedPixels\": " << a.comparedPixels
+               << ", \"validMismatch\": " << a.validMismatch
+               << ", \"errorMean\": " << a.errorMean
+               << ", \"errorP99\": " << a.errorP99
+               << ", \"errorMax\": " << a.errorMax << " }"
+               << (i + 1 < accuracy.size() ? "," : "") << "\n";
+        }
+        os << "  ]\n}\n";
+        return (bool)os;
+    }
+
+private:
+    fs::path fixtures;
+    int iterations;
+    ProjectorConfig projectors[BENCH_PROJECTOR_COUNT];
+    std::vector<BenchResult> results;
+    std::vector<DecodeAccuracy> accuracy;
+
+    // Stages write into the capture folders, so they work on a fresh copy of the fixtures
+    bool prepareWorkingDirectory() {
+        fs::path workingDirectory = fs::temp_directory_path() / "ClimbPM_bench";
+        std::error_code error;
+        fs::remove_all(workingDirectory, error);
+        fs::create_directories(workingDirectory, error);
+        for (int i = 1; i <= BENCH_PROJECTOR_COUNT; i++) {
+            std::string folder = "captured" + std::to_string(i);
+            fs::copy(fs::absolute(fixtures) / folder, workingDirectory / folder, fs::copy_options::recursive, error);
+            if (error) {
+                std::cerr << "Could not copy \"" << (fixtures / folder).string() << "\": " << error.message() << std::endl;
+                return false;
+            }
+        }
+        fs::current_path(workingDirectory);
+        std::cerr << "Benchmarking in \"" << workingDirectory.string() << "\"" << std::endl;
+        return true;
+    }
+
+    static DecodeAccuracy compareDecodes(int projector, const Mat& pyramidMap, const Mat& pyramidValid,
+                                         const Mat& fullMap, const Mat& fullValid) {
+        DecodeAccuracy result{ projector, 0, countNonZero(pyramidValid != fullValid), 0.0, 0.0, 0.0 };
+        std::vector<float> errors;
+        for (int y = 0; y < fullMap.rows; y++) {
+            const Vec2w* pyramidRow = pyramidMap.ptr<Vec2w>(y);
+            const Vec2w* fullRow = fullMap.ptr<Vec2w>(y);
+            const uchar* pyramidValidRow = pyramidValid.ptr<uchar>(y);
+            const uchar* fullValidRow = fullValid.ptr<uchar>(y);
+            for (int x = 0; x < fullMap.cols; x++) {
+                if (!pyramidValidRow[x] || !fullValidRow[x]) continue;
+                float dx = (float)pyramidRow[x][0] - fullRow[x][0], dy = (float)pyramidRow[x][1] - fullRow[x][1];
+                errors.push_back(std::sqrt(dx * dx + dy * dy));
+            }
+        }
+        result.comparedPixels = (int)errors.size();
+        if (errors.empty()) return result;
+        double sum = 0.0;
+        for (float error : errors) sum += error;
+        result.errorMean = sum / errors.size();
+        std::sort(errors.begin(), errors.end());
+        result.errorP99 = errors[errors.size() * 99 / 100];
+        result.errorMax = errors.back();
+        return result;
+    }
+
+    // setup runs before every iteration, outside of the timing
+    void measure(const std::string& stage, int projector, const std::function<void()>& body,
+                 const std::function<void()>& setup = nullptr) {
+        BenchResult result{ stage, projector, {} };
+        for (int i = 0; i < iterations; i++) {
+            if (setup) setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            result.timesMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cerr << stage << (projector > 0 ? " (projector " + std::to_string(projector) + ")" : "") << ": "
+                  << result.timesMs.front() << " ms first run" << std::endl;
+        results.push_back(result);
+    }
+};
+
+int main(int argc, char** argv) {
+    fs::path fixtures = "../Resources/captured examples";
+    int iterations = 5;
+    std::string output;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--fixtures") fixtures = argv[i + 1];
+        else if (option == "--iterations") iterations = std::max(1, std::atoi(argv[i + 1]));
+        else if (option == "--output") output = argv[i + 1];
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return -1;
+        }
+    }
+    // Resolved before the benchmark changes into its working directory
+    fixtures = fs::absolute(fixtures);
+    if (!output.empty()) output = fs::absolute(output).string();
+
+    // Stage output goes to stderr, so stdout only holds the JSON
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    Benchmark benchmark(fixtures, iterations);
+    bool success = benchmark.run();
+    std::cout.rdbuf(stdoutBuffer);
+    if (!success) return -1;
+
+    if (output.empty())
+        return benchmark.writeJSON(std::cout) ? 0 : -1;
+    std::ofstream os(output);
+    if (!os.is_open() || !benchmark.writeJSON(os)) {
+        std::cerr << "Could not write \"" << output << "\"!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+//
+// Thread-safe FIFO queue with a fixed capacity.
+//
+
+#ifndef CLIMBPM_BOUNDEDQUEUE_H
+#define CLIMBPM_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    // Blocks while the queue is full, returns false if the queue was closed
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Never blocks: if the queue is full, the oldest item is discarded to make room.
+    // Returns the number of discarded items (0 or 1), or -1 if the queue was closed
+    int pushDropOldest(T&& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) return -1;
+        int dropped = 0;
+        if (items.size() >= capacity) {
+            items.pop_front();
+            dropped = 1;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return dropped;
+    }
+
+    // Takes the oldest item if there is one, never blocks
+    bool tryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Whether the queue was closed and all items have been taken
+    bool isFinished() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed && items.empty();
+    }
+
+    // Blocks until an item is available, returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes up all waiting threads, remaining items can still be popped
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+};
+
+
+#endif //CLIMBPM_BOUNDEDQUEUE_H
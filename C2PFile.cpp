@@ -0,0 +1,221 @@
+//
+// Binary camera-to-projector calibration file.
+//
+
+#include "C2PFile.h"
+#include <opencv2/imgproc.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------------------------------------
+// ------------------------- MAPPED FILE ----------------------
+// ------------------------------------------------------------
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) : data(nullptr), length(0), fileHandle(nullptr), mappingHandle(nullptr) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) return;
+    mappingHandle = mapping;
+
+    data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data != nullptr) length = (size_t)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mappingHandle != nullptr) CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle != nullptr) CloseHandle((HANDLE)fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string& path) : data(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            // The whole file is copied out right after mapping
+            madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+            data = (const unsigned char*)mapped;
+            length = (size_t)st.st_size;
+        }
+    }
+    // The mapping stays valid after closing the descriptor
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) munmap((void*)data, length);
+}
+#endif
+
+// ------------------------------------------------------------
+// ------------------------- BINARY FORMAT --------------------
+// ------------------------------------------------------------
+
+bool C2PFile::write(const std::string& path, const C2PFileHeader& header, const Mat& coords, const Mat& valid) {
+    CV_Assert(coords.type() == CV_16UC2 && valid.type() == CV_8UC1);
+    CV_Assert(coords.cols == (int)header.camWidth && coords.rows == (int)header.camHeight);
+    CV_Assert(valid.size() == coords.size());
+
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    // Projectors often cover a small part of the camera image, everything around their mapped area is left out
+    Rect region = boundingRect(valid);
+    C2PFileHeader regionHeader = header;
+    regionHeader.version = C2P_FILE_VERSION;
+    regionHeader.regionX = region.x;
+    regionHeader.regionY = region.y;
+    regionHeader.regionWidth = region.width;
+    regionHeader.regionHeight = region.height;
+    os.write((const char*)&regionHeader, sizeof(regionHeader));
+    for (int y = region.y; y < region.y + region.height; y++)
+        os.write((const char*)coords.ptr<Vec2w>(y, region.x), (std::streamsize)region.width * coords.elemSize());
+    for (int y = region.y; y < region.y + region.height; y++)
+        os.write((const char*)valid.ptr<uchar>(y, region.x), region.width);
+    os.close();
+
+    if (!os) {
+        std::cerr << "Error writing c2p file \"" << path << "\"!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool C2PFile::read(const std::string& path, C2PFileHeader& header, Mat& coords, Mat& valid) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+
+    if (file.size() < C2P_FILE_V1_HEADER_SIZE) {
+        std::cerr << "C2P file \"" << path << "\" is truncated!" << std::endl;
+        return false;
+    }
+    header = C2PFileHeader();
+    std::memcpy(&header, file.ptr(), C2P_FILE_V1_HEADER_SIZE);
+    if (header.magic != C2P_FILE_MAGIC) {
+        std::cerr << "\"" << path << "\" is not a c2p file!" << std::endl;
+        return false;
+    }
+    size_t headerSize = C2P_FILE_V1_HEADER_SIZE;
+    if (header.version == 1) {
+        header.regionX = header.regionY = 0;
+        header.regionWidth = header.camWidth;
+        header.regionHeight = header.camHeight;
+    } else if (header.version == C2P_FILE_VERSION && file.size() >= sizeof(C2PFileHeader)) {
+        std::memcpy(&header, file.ptr(), sizeof(C2PFileHeader));
+        headerSize = sizeof(C2PFileHeader);
+    } else {
+        std::cerr << "C2P file \"" << path << "\" has unsupported version " << header.version
+                  << " (expected " << C2P_FILE_VERSION << ")!" << std::endl;
+        return false;
+    }
+    if ((uint64_t)header.regionX + header.regionWidth > header.camWidth
+        || (uint64_t)header.regionY + header.regionHeight > header.camHeight) {
+        std::cerr << "C2P file \"" << path << "\" stores a region outside the camera image!" << std::endl;
+        return false;
+    }
+
+    size_t pixelCount = (size_t)header.regionWidth * header.regionHeight;
+    size_t expectedSize = headerSize + pixelCount * 2 * sizeof(uint16_t) + pixelCount;
+    if (file.size() != expectedSize) {
+        std::cerr << "C2P file \"" << path << "\" has size " << file.size() << " but " << expectedSize
+                  << " bytes were expected!" << std::endl;
+        return false;
+    }
+
+    const unsigned char* coordData = file.ptr() + headerSize;
+    const unsigned char* validData = coordData + pixelCount * 2 * sizeof(uint16_t);
+    coords = Mat::zeros((int)header.camHeight, (int)header.camWidth, CV_16UC2);
+    valid = Mat::zeros((int)header.camHeight, (int)header.camWidth, CV_8UC1);
+    if (pixelCount == 0) return true;
+    // Wrap the mapped memory and copy it out before the mapping is closed
+    Rect region((int)header.regionX, (int)header.regionY, (int)header.regionWidth, (int)header.regionHeight);
+    Mat((int)header.regionHeight, (int)header.regionWidth, CV_16UC2, (void*)coordData).copyTo(coords(region));
+    Mat((int)header.regionHeight, (int)header.regionWidth, CV_8UC1, (void*)validData).copyTo(valid(region));
+    return true;
+}
+
+// ------------------------------------------------------------
+// ------------------------- CSV IMPORT/EXPORT ----------------
+// ------------------------------------------------------------
+
+bool C2PFile::exportCSV(const std::string& path, const Mat& coords, const Mat& valid) {
+    std::ofstream os(path);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    // Unmapped pixels are written as (0, 0), as the legacy format does not know about validity
+    for (int y = 0; y < coords.rows; y++) {
+        const Vec2w* coordRow = coords.ptr<Vec2w>(y);
+        const uchar* validRow = valid.ptr<uchar>(y);
+        for (int x = 0; x < coords.cols; x++) {
+            int px = validRow[x] ? coordRow[x][0] : 0;
+            int py = validRow[x] ? coordRow[x][1] : 0;
+            os << x << ", " << y << ", " << px << ", " << py << '\n';
+        }
+    }
+    os.close();
+    return (bool)os;
+}
+
+bool C2PFile::importCSV(const std::string& path, uint camWidth, uint camHeight, Mat& coords, Mat& valid) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    coords = Mat::zeros((int)camHeight, (int)camWidth, CV_16UC2);
+    valid = Mat::zeros((int)camHeight, (int)camWidth, CV_8UC1);
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const char* cursor = line.c_str();
+        long data[4];
+        int index = 0;
+        for (; index < 4; index++) {
+            char* end;
+            data[index] = std::strtol(cursor, &end, 10);
+            if (end == cursor) break;
+            cursor = end;
+            while (*cursor == ',' || *cursor == ' ') cursor++;
+        }
+
+        if (index != 4) {
+            std::cerr << "Malformed line in CSV file: " << line << std::endl;
+            continue;
+        }
+        if (data[0] < 0 || data[0] >= camWidth || data[1] < 0 || data[1] >= camHeight) {
+            std::cerr << "Camera pixel out of range in CSV file: " << line << std::endl;
+            continue;
+        }
+        coords.at<Vec2w>((int)data[1], (int)data[0]) = Vec2w((ushort)data[2], (ushort)data[3]);
+        // Legacy convention: (0, 0) marks an unmapped pixel
+        valid.at<uchar>((int)data[1], (int)data[0]) = (data[2] + data[3] != 0) ? 255 : 0;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+//
+// Binary camera-to-projector calibration file.
+//
+
+#ifndef CLIMBPM_C2PFILE_H
+#define CLIMBPM_C2PFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <opencv2/core.hpp>
+
+#define C2P_FILE_MAGIC 0x50324343u // "CC2P"
+#define C2P_FILE_VERSION 2
+// Version 1 headers end before the stored region and always hold the whole camera image
+#define C2P_FILE_V1_HEADER_SIZE 32
+
+using namespace cv;
+
+// Fixed size header at the start of every c2p.bin file.
+// It is followed by the projector coordinates of every camera pixel in the stored region (2 x uint16, row-major)
+// and then one validity byte per camera pixel of the region (0 = unmapped, 255 = mapped).
+// Camera pixels outside the region are unmapped.
+struct C2PFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t camWidth;
+    uint32_t camHeight;
+    uint32_t projectorId;
+    uint32_t projWidth;
+    uint32_t projHeight;
+    uint32_t reserved;
+    // Stored region of the camera image, set by C2PFile::write() to the bounding box of the mapped pixels
+    uint32_t regionX;
+    uint32_t regionY;
+    uint32_t regionWidth;
+    uint32_t regionHeight;
+    C2PFileHeader(uint32_t id, uint32_t camW, uint32_t camH, uint32_t projW, uint32_t projH)
+    : magic(C2P_FILE_MAGIC), version(C2P_FILE_VERSION), camWidth(camW), camHeight(camH),
+      projectorId(id), projWidth(projW), projHeight(projH), reserved(0),
+      regionX(0), regionY(0), regionWidth(camW), regionHeight(camH) { }
+    C2PFileHeader() : C2PFileHeader(0, 0, 0, 0, 0) {}
+};
+
+// Read-only memory mapping of a complete file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return data != nullptr; }
+    const unsigned char* ptr() const { return data; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* data;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+class C2PFile {
+public:
+    // Writes the coordinate map (CV_16UC2) and validity mask (CV_8UC1) as binary c2p file,
+    // only the bounding box of the mapped camera pixels is stored
+    static bool write(const std::string& path, const C2PFileHeader& header, const Mat& coords, const Mat& valid);
+    // Maps the binary c2p file (version 1 or 2) into memory and copies its content into full size coords and valid
+    static bool read(const std::string& path, C2PFileHeader& header, Mat& coords, Mat& valid);
+
+    // Legacy text format ("cx, cy, px, py" per camera pixel), only used for import/export
+    static bool exportCSV(const std::string& path, const Mat& coords, const Mat& valid);
+    static bool importCSV(const std::string& path, uint camWidth, uint camHeight, Mat& coords, Mat& valid);
+};
+
+
+#endif //CLIMBPM_C2PFILE_H
@@ -0,0 +1,145 @@
+//
+// Background thread that drains a camera into a small ring of preallocated, timestamped frames.
+//
+
+#include "CameraGrabber.h"
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+CameraGrabber::CameraGrabber()
+: conversion(CAMERA_BGR), newest(0), sequence(0), reallocations(0), running(false) {}
+
+CameraGrabber::~CameraGrabber() {
+    close();
+}
+
+bool CameraGrabber::open(int index, int apiPreference, bool grayscale) {
+    close();
+    if (!capture.open(index, apiPreference)) {
+        std::cerr << "Could not open camera " << index << "!" << std::endl;
+        return false;
+    }
+
+    // Undecoded frames of YUYV cameras hold the Y plane in every other byte, which spares the color conversion
+    conversion = CAMERA_BGR;
+    if (grayscale) {
+        capture.set(CAP_PROP_CONVERT_RGB, 0);
+        if (capture.read(raw) && raw.rows > 1 && raw.type() == CV_8UC2) {
+            conversion = CAMERA_Y_FROM_YUYV;
+        } else if (!raw.empty() && raw.rows > 1 && raw.type() == CV_8UC1) {
+            conversion = CAMERA_GRAY;
+        } else {
+            capture.set(CAP_PROP_CONVERT_RGB, 1);
+            conversion = CAMERA_GRAY_FROM_BGR;
+        }
+    }
+
+    // The first frame sets the size of the ring's preallocated frames
+    Mat first;
+    if (!capture.grab() || !retrieve(first) || first.empty()) {
+        std::cerr << "Camera " << index << " delivers no frames!" << std::endl;
+        capture.release();
+        return false;
+    }
+    frameSize = first.size();
+    ring.assign(CAMERA_RING_SIZE, CameraFrame());
+    for (CameraFrame& slot : ring)
+        slot.image.create(frameSize, first.type());
+    newest = 0;
+    sequence = 0;
+    reallocations = 0;
+
+    running = true;
+    thread = std::thread(&CameraGrabber::run, this);
+    return true;
+}
+
+void CameraGrabber::close() {
+    running = false;
+    if (thread.joinable()) thread.join();
+    frameReady.notify_all();
+    if (capture.isOpened()) capture.release();
+}
+
+bool CameraGrabber::retrieve(Mat& image) {
+    switch (conversion) {
+    case CAMERA_Y_FROM_YUYV:
+        if (!capture.retrieve(raw)) return false;
+        extractChannel(raw, image, 0);
+        return true;
+    case CAMERA_GRAY_FROM_BGR:
+        if (!capture.retrieve(raw)) return false;
+        cvtColor(raw, image, COLOR_BGR2GRAY);
+        return true;
+    default:
+        return capture.retrieve(image);
+    }
+}
+
+void CameraGrabber::run() {
+    while (running) {
+        if (!capture.grab()) {
+            std::cerr << "Camera stopped delivering frames!" << std::endl;
+            break;
+        }
+        auto timestamp = std::chrono::steady_clock::now();
+
+        // The oldest slot is reused, unless a consumer still holds its frame. Consumers only take frames under the
+        // lock, so the reference count cannot grow after the check.
+        size_t slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot = (newest + 1) % ring.size();
+            ring[slot].sequence = 0;
+            if (ring[slot].image.u != nullptr && ring[slot].image.u->refcount > 1) {
+                ring[slot].image = Mat();
+                reallocations++;
+            }
+        }
+        // Unpublished (sequence 0), so no consumer takes the slot while it is written
+        if (!retrieve(ring[slot].image)) continue;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ring[slot].timestamp = timestamp;
+            ring[slot].sequence = ++sequence;
+            newest = slot;
+        }
+        frameReady.notify_all();
+    }
+    running = false;
+    frameReady.notify_all();
+}
+
+// ------------------------------------------------------------
+// ------------------------- CONSUMERS ------------------------
+// ------------------------------------------------------------
+
+bool CameraGrabber::latestFrame(CameraFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ring.empty() || ring[newest].sequence == 0) return false;
+    frame = ring[newest];
+    return true;
+}
+
+int CameraGrabber::findAfter(std::chrono::steady_clock::time_point time) const {
+    int found = -1;
+    for (size_t i = 0; i < ring.size(); i++) {
+        if (ring[i].sequence == 0 || ring[i].timestamp < time) continue;
+        if (found < 0 || ring[i].sequence < ring[found].sequence) found = (int)i;
+    }
+    return found;
+}
+
+bool CameraGrabber::frameAfter(std::chrono::steady_clock::time_point time, CameraFrame& frame, uint timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    frameReady.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return !running || findAfter(time) >= 0; });
+    int slot = findAfter(time);
+    if (slot < 0) return false;
+    frame = ring[slot];
+    return true;
+}
+
+uint64_t CameraGrabber::getReallocations() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return reallocations;
+}
@@ -0,0 +1,92 @@
+//
+// Background thread that drains a camera into a small ring of preallocated, timestamped frames.
+//
+
+#ifndef CLIMBPM_CAMERAGRABBER_H
+#define CLIMBPM_CAMERAGRABBER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+// Frames kept by the grabber, older ones are overwritten unless a consumer still holds them
+#define CAMERA_RING_SIZE 4
+// How long consumers wait for a frame before giving up (ms)
+#define CAMERA_TIMEOUT_MS 2000
+
+using namespace cv;
+
+// A frame shares its pixels with the grabber's ring: it stays valid as long as it is held, but must not be modified
+// while other consumers may hold it as well
+struct CameraFrame {
+    Mat image;
+    // When the grabber received the frame
+    std::chrono::steady_clock::time_point timestamp;
+    // Counts up from 1 with every frame, 0 = no frame
+    uint64_t sequence;
+    CameraFrame() : sequence(0) {}
+};
+
+// How camera frames become the frames in the ring
+enum CameraConversion {
+    // BGR as decoded by the backend
+    CAMERA_BGR,
+    // The backend already delivers one channel
+    CAMERA_GRAY,
+    // Y plane of the packed YUYV frames the camera sends, without color conversion
+    CAMERA_Y_FROM_YUYV,
+    // The backend only delivers BGR (e.g. MJPEG cameras), converted to gray on the grabber thread
+    CAMERA_GRAY_FROM_BGR
+};
+
+class CameraGrabber {
+public:
+    CameraGrabber();
+    ~CameraGrabber();
+
+    // Opens the camera and starts grabbing, grayscale rings hold single channel frames (Y plane if the camera allows)
+    bool open(int index, int apiPreference, bool grayscale);
+    void close();
+    bool isOpened() const { return running; }
+    Size getFrameSize() const { return frameSize; }
+    CameraConversion getConversion() const { return conversion; }
+
+    // Newest frame, never blocks. Returns false before the first frame.
+    bool latestFrame(CameraFrame& frame);
+    // Oldest frame received at or after time, waits for it if there is none yet.
+    // Returns false on timeout or when the camera stopped.
+    bool frameAfter(std::chrono::steady_clock::time_point time, CameraFrame& frame, uint timeoutMs = CAMERA_TIMEOUT_MS);
+    // Frames whose slot was still held by a consumer when it was due, so a new buffer had to be allocated
+    uint64_t getReallocations();
+
+private:
+    VideoCapture capture;
+    CameraConversion conversion;
+    Size frameSize;
+    std::vector<CameraFrame> ring;
+    // Slot of the newest frame
+    size_t newest;
+    uint64_t sequence;
+    uint64_t reallocations;
+    // Undecoded frame, for conversions that do not retrieve into the ring directly
+    Mat raw;
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    // Retrieves the grabbed frame into image with the conversion of this camera
+    bool retrieve(Mat& image);
+    // Slot of the oldest published frame at or after time, -1 if there is none
+    int findAfter(std::chrono::steady_clock::time_point time) const;
+    void run();
+};
+
+
+#endif //CLIMBPM_CAMERAGRABBER_H
@@ -0,0 +1,56 @@
+//
+// Reusable barrier that keeps a fixed number of threads in lockstep.
+//
+
+#ifndef CLIMBPM_FRAMEBARRIER_H
+#define CLIMBPM_FRAMEBARRIER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+class FrameBarrier {
+public:
+    explicit FrameBarrier(size_t count) : count(count), arrived(0), generation(0), closed(false) {}
+
+    // Blocks until all threads arrived, the last one runs completion before any of them continues.
+    // Returns false if the barrier was closed.
+    template <typename Completion>
+    bool arriveAndWait(Completion completion) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed) return false;
+        if (++arrived == count) {
+            completion();
+            arrived = 0;
+            generation++;
+            allArrived.notify_all();
+            return true;
+        }
+        uint64_t arrivedGeneration = generation;
+        allArrived.wait(lock, [&] { return closed || generation != arrivedGeneration; });
+        return generation != arrivedGeneration;
+    }
+
+    bool arriveAndWait() {
+        return arriveAndWait([] {});
+    }
+
+    // Releases all waiting threads, later arrivals return right away
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        allArrived.notify_all();
+    }
+
+private:
+    const size_t count;
+    size_t arrived;
+    uint64_t generation;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable allArrived;
+};
+
+
+#endif //CLIMBPM_FRAMEBARRIER_H
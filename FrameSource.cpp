@@ -0,0 +1,37 @@
+//
+// Sources of timestamped frames for video playback.
+//
+
+#include "FrameSource.h"
+
+VideoCaptureSource::VideoCaptureSource(const std::string& filename)
+: capture(filename), live(false), fps(0.0), frameIndex(0) {
+    fps = capture.get(CAP_PROP_FPS);
+    // Streams without a frame count have no timing of their own
+    live = capture.get(CAP_PROP_FRAME_COUNT) <= 0;
+}
+
+VideoCaptureSource::VideoCaptureSource(int cameraIndex)
+: capture(cameraIndex), live(true), fps(0.0), frameIndex(0) {
+    fps = capture.get(CAP_PROP_FPS);
+}
+
+bool VideoCaptureSource::read(Mat& frame, double& timestampMs) {
+    // Always decode into a new buffer, the previous frame may still be in use by other threads
+    frame = Mat();
+    if (!capture.read(frame) || frame.empty()) return false;
+
+    auto now = std::chrono::steady_clock::now();
+    if (frameIndex == 0) start = now;
+
+    if (live) {
+        timestampMs = std::chrono::duration<double, std::milli>(now - start).count();
+    } else {
+        timestampMs = capture.get(CAP_PROP_POS_MSEC);
+        // Not every backend reports positions, fall back to the nominal frame rate
+        if (timestampMs <= 0.0 && frameIndex > 0 && fps > 0.0)
+            timestampMs = frameIndex * 1000.0 / fps;
+    }
+    frameIndex++;
+    return true;
+}
@@ -0,0 +1,44 @@
+//
+// Sources of timestamped frames for video playback.
+//
+
+#ifndef CLIMBPM_FRAMESOURCE_H
+#define CLIMBPM_FRAMESOURCE_H
+
+#include <chrono>
+#include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace cv;
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    // Reads the next frame (into a new buffer) and its presentation time relative to the source start (ms).
+    // Returns false at the end of the source.
+    virtual bool read(Mat& frame, double& timestampMs) = 0;
+    // Live sources are presented as soon as possible, files keep their own timing
+    virtual bool isLive() const = 0;
+};
+
+// Video file, image sequence, camera or network stream opened through cv::VideoCapture
+class VideoCaptureSource : public FrameSource {
+public:
+    explicit VideoCaptureSource(const std::string& filename);
+    explicit VideoCaptureSource(int cameraIndex);
+
+    bool isOpened() const { return capture.isOpened(); }
+    bool read(Mat& frame, double& timestampMs) override;
+    bool isLive() const override { return live; }
+
+private:
+    VideoCapture capture;
+    bool live;
+    double fps;
+    uint64_t frameIndex;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#endif //CLIMBPM_FRAMESOURCE_H
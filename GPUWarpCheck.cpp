@@ -0,0 +1,98 @@
+//
+// Checks the shader warp against warpImage() on a hidden window (ClimbPM_gpucheck). Decodes one projector of the
+// example captures, renders a test image through the GPU and fails if too many pixels differ from the CPU warp:
+//   ClimbPM_gpucheck [--fixtures <dir>] [--projector <n>] [--threshold <share of pixels>]
+// Without a GPU or display, run it with Mesa's software rasterizer in a virtual framebuffer:
+//   xvfb-run -a -s "-screen 0 1920x1080x24" env LIBGL_ALWAYS_SOFTWARE=1 ./ClimbPM_gpucheck
+//
+
+#include "ProjectorConfig.h"
+
+// Resolution of the projectors the example captures were taken with (captured1 and captured2)
+#define GPUCHECK_PROJECTOR_WIDTH 1920
+#define GPUCHECK_PROJECTOR_HEIGHT 1080
+// Largest share of pixels that may differ by more than the tolerance between the GPU and the CPU warp
+#define GPUCHECK_MAX_FAILED 0.01
+
+// Decoding writes into the capture folder, so it works on a fresh copy of the fixture
+static bool prepareWorkingDirectory(const fs::path& fixtures, int projector) {
+    fs::path workingDirectory = fs::temp_directory_path() / "ClimbPM_gpucheck";
+    std::error_code error;
+    fs::remove_all(workingDirectory, error);
+    fs::create_directories(workingDirectory, error);
+    std::string folder = "captured" + std::to_string(projector);
+    fs::copy(fixtures / folder, workingDirectory / folder, fs::copy_options::recursive, error);
+    if (error) {
+        std::cerr << "Could not copy \"" << (fixtures / folder).string() << "\": " << error.message() << std::endl;
+        return false;
+    }
+    fs::current_path(workingDirectory);
+    return true;
+}
+
+// Smooth gradients, so that differences come from the warp and not from sampling sharp edges
+static Mat createTestImage() {
+    Mat img(ProjectorConfig::CAMHEIGHT, ProjectorConfig::CAMWIDTH, CV_8UC3);
+    for (int y = 0; y < img.rows; y++) {
+        Vec3b* row = img.ptr<Vec3b>(y);
+        for (int x = 0; x < img.cols; x++) {
+            row[x] = Vec3b(saturate_cast<uchar>(255.0 * x / img.cols),
+                           saturate_cast<uchar>(255.0 * y / img.rows),
+                           saturate_cast<uchar>(127.5 + 127.5 * std::cos(x * 0.01) * std::sin(y * 0.01)));
+        }
+    }
+    return img;
+}
+
+int main(int argc, char** argv) {
+    fs::path fixtures = "../Resources/captured examples";
+    int projectorId = 1;
+    double threshold = GPUCHECK_MAX_FAILED;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--fixtures") fixtures = argv[i + 1];
+        else if (option == "--projector") projectorId = std::max(1, std::atoi(argv[i + 1]));
+        else if (option == "--threshold") threshold = std::atof(argv[i + 1]);
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return -1;
+        }
+    }
+    if (!prepareWorkingDirectory(fs::absolute(fixtures), projectorId)) return -1;
+
+    // Same calibration as main(), from the captures instead of the camera
+    std::string whitePath = "captured" + std::to_string(projectorId) + "/cam_00.png";
+    Mat firstWhite = imread(whitePath, IMREAD_GRAYSCALE);
+    if (firstWhite.empty()) {
+        std::cerr << "No captures found at \"" << whitePath << "\"!" << std::endl;
+        return -1;
+    }
+    ProjectorConfig::CAMWIDTH = firstWhite.cols;
+    ProjectorConfig::CAMHEIGHT = firstWhite.rows;
+    ProjectorConfig projector(ProjectorParams(projectorId, GPUCHECK_PROJECTOR_WIDTH, GPUCHECK_PROJECTOR_HEIGHT, 0, 0));
+    projector.loadGraycodes();
+    projector.decodeGraycode();
+    if (projector.getHomography().empty()) {
+        std::cerr << "Projector " << projectorId << " could not be calibrated!" << std::endl;
+        return -1;
+    }
+
+    if (!ProjectorConfig::initGLFW()) {
+        std::cerr << "Could not initialize GLFW, is a display (or xvfb-run) available?" << std::endl;
+        return -1;
+    }
+    if (!projector.openWindow(nullptr, false)) {
+        glfwTerminate();
+        return -1;
+    }
+    double failed = projector.verifyGPUWarp(createTestImage());
+    glfwTerminate();
+
+    if (failed > threshold) {
+        std::cerr << "GPU warp differs from the CPU warp at " << failed * 100.0 << " % of pixels, more than the allowed "
+                  << threshold * 100.0 << " %!" << std::endl;
+        return -1;
+    }
+    std::cout << "GPU warp matches the CPU warp" << std::endl;
+    return 0;
+}
@@ -0,0 +1,206 @@
+//
+// Bit-plane graycode decoder, alternative to structured_light::GrayCodePattern::getProjPixel().
+//
+
+#include "GraycodeDecoder.h"
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core/hal/intrin.hpp>
+
+// Function style universal intrinsics (v_gt, v_or, VTraits, ...) are available since OpenCV 4.9.
+// Scalable vector types cannot be stored in arrays, so only fixed width SIMD is used.
+#if CV_SIMD && (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9))
+#define CLIMBPM_DECODE_SIMD 1
+#else
+#define CLIMBPM_DECODE_SIMD 0
+#endif
+
+GraycodeDecoder::GraycodeDecoder(uint projWidth, uint projHeight, uint whiteThreshold)
+: width(projWidth), height(projHeight), whiteThreshold(whiteThreshold) {
+    // Same image count as structured_light::GrayCodePattern
+    colBits = (int)std::ceil(std::log(double(projWidth)) / std::log(2.0));
+    rowBits = (int)std::ceil(std::log(double(projHeight)) / std::log(2.0));
+    CV_Assert(colBits <= 16 && rowBits <= 16 && getImageCount() <= GRAYCODE_MAX_IMAGES);
+}
+
+void GraycodeDecoder::decodeRows(const std::vector<Mat>& patternImages, int rowStart, int rowEnd, Mat& projCoords, Mat& flags) const {
+    CV_Assert(patternImages.size() >= getImageCount());
+    const int rows = patternImages[0].rows, cols = patternImages[0].cols;
+    CV_Assert(projCoords.type() == CV_16UC2 && projCoords.rows == rows && projCoords.cols == cols);
+    CV_Assert(flags.type() == CV_8UC1 && flags.size() == projCoords.size());
+
+    std::vector<const uchar*> rowPtrs(getImageCount());
+    for (int y = rowStart; y < rowEnd; y++) {
+        for (size_t i = 0; i < rowPtrs.size(); i++)
+            rowPtrs[i] = patternImages[i].ptr<uchar>(y);
+        decodeRow(rowPtrs.data(), cols, projCoords.ptr<Vec2w>(y), flags.ptr<uchar>(y));
+    }
+}
+
+void GraycodeDecoder::decodeSpan(const std::vector<Mat>& patternImages, int y, int colStart, int colEnd, Mat& projCoords, Mat& flags) const {
+    CV_Assert(patternImages.size() >= getImageCount());
+    CV_Assert(projCoords.type() == CV_16UC2 && projCoords.size() == patternImages[0].size());
+    CV_Assert(flags.type() == CV_8UC1 && flags.size() == projCoords.size());
+    CV_Assert(0 <= colStart && colStart <= colEnd && colEnd <= projCoords.cols);
+    if (colStart == colEnd) return;
+
+    // decodeRow() only sees the pixels of the span
+    const uchar* rowPtrs[GRAYCODE_MAX_IMAGES];
+    for (size_t i = 0; i < getImageCount(); i++)
+        rowPtrs[i] = patternImages[i].ptr<uchar>(y) + colStart;
+    decodeRow(rowPtrs, colEnd - colStart, projCoords.ptr<Vec2w>(y) + colStart, flags.ptr<uchar>(y) + colStart);
+}
+
+uint GraycodeDecoder::decodeTiles(const std::vector<Mat>& patternImages, const Mat& mask, Rect area, int tileSize,
+                                  float tolerance, Mat& projCoords, Mat& flags) const {
+    CV_Assert(patternImages.size() >= getImageCount() && tileSize > 0);
+    CV_Assert(mask.type() == CV_8UC1 && mask.size() == projCoords.size());
+    uint decoded = 0;
+    for (int y0 = area.y; y0 < area.y + area.height; y0 += tileSize) {
+        for (int x0 = area.x; x0 < area.x + area.width; x0 += tileSize) {
+            Rect tile(x0, y0, std::min(tileSize, area.x + area.width - x0), std::min(tileSize, area.y + area.height - y0));
+            int maskCount = countNonZero(mask(tile));
+            if (maskCount == 0) {
+                flags(tile).setTo(Scalar(0));
+                continue;
+            }
+            if (maskCount == tile.area() && interpolateTile(patternImages, tile, tolerance, projCoords, flags))
+                continue;
+            for (int y = tile.y; y < tile.y + tile.height; y++)
+                decodeSpan(patternImages, y, tile.x, tile.x + tile.width, projCoords, flags);
+            decoded += maskCount;
+        }
+    }
+    return decoded;
+}
+
+bool GraycodeDecoder::decodePixel(const std::vector<Mat>& patternImages, int x, int y, Vec2w& coord) const {
+    const uchar* rowPtrs[GRAYCODE_MAX_IMAGES];
+    for (size_t i = 0; i < getImageCount(); i++)
+        rowPtrs[i] = patternImages[i].ptr<uchar>(y) + x;
+    uchar flag;
+    decodeRow(rowPtrs, 1, &coord, &flag);
+    return flag != 0;
+}
+
+bool GraycodeDecoder::interpolateTile(const std::vector<Mat>& patternImages, Rect tile, float tolerance,
+                                      Mat& projCoords, Mat& flags) const {
+    const int xs[2] = { tile.x, tile.x + tile.width - 1 };
+    const int ys[2] = { tile.y, tile.y + tile.height - 1 };
+    Vec2w corners[2][2], center;
+    bool centerFlag = decodePixel(patternImages, tile.x + tile.width / 2, tile.y + tile.height / 2, center);
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < 2; i++) {
+            // All samples have to agree on the flag
+            if (decodePixel(patternImages, xs[i], ys[j], corners[j][i]) != centerFlag) return false;
+        }
+    }
+
+    auto interpolate = [&](int x, int y, int axis) {
+        float u = (xs[1] > xs[0]) ? (float)(x - xs[0]) / (xs[1] - xs[0]) : 0.0f;
+        float v = (ys[1] > ys[0]) ? (float)(y - ys[0]) / (ys[1] - ys[0]) : 0.0f;
+        return (1.0f - v) * ((1.0f - u) * corners[0][0][axis] + u * corners[0][1][axis])
+               + v * ((1.0f - u) * corners[1][0][axis] + u * corners[1][1][axis]);
+    };
+    for (int axis = 0; axis < 2; axis++) {
+        // Opposite edges step alike where the codes change smoothly, a wrong bit in one corner breaks that
+        float topStep = (float)corners[0][1][axis] - corners[0][0][axis];
+        float bottomStep = (float)corners[1][1][axis] - corners[1][0][axis];
+        float leftStep = (float)corners[1][0][axis] - corners[0][0][axis];
+        float rightStep = (float)corners[1][1][axis] - corners[0][1][axis];
+        if (std::abs(topStep - bottomStep) > tolerance || std::abs(leftStep - rightStep) > tolerance) return false;
+        float centerValue = interpolate(tile.x + tile.width / 2, tile.y + tile.height / 2, axis);
+        if (std::abs(centerValue - center[axis]) > tolerance) return false;
+    }
+
+    const uchar flag = centerFlag ? 255 : 0;
+    for (int y = tile.y; y < tile.y + tile.height; y++) {
+        Vec2w* coordRow = projCoords.ptr<Vec2w>(y);
+        uchar* flagRow = flags.ptr<uchar>(y);
+        for (int x = tile.x; x < tile.x + tile.width; x++) {
+            coordRow[x] = Vec2w((ushort)cvRound(interpolate(x, y, 0)), (ushort)cvRound(interpolate(x, y, 1)));
+            flagRow[x] = flag;
+        }
+    }
+    return true;
+}
+
+void GraycodeDecoder::decodeRow(const uchar* const* rows, int cols, Vec2w* coordRow, uchar* flagRow) const {
+    const uchar* const* colRows = rows;
+    const uchar* const* rowRows = rows + 2 * colBits;
+    int x = 0;
+
+#if CLIMBPM_DECODE_SIMD
+    // A difference below 256 is always true for thresholds above 255, the scalar path handles that case
+    if (whiteThreshold <= 255) {
+        const int lanes = VTraits<v_uint8>::vlanes();
+        const v_uint8 thresholdV = vx_setall_u8((uchar)whiteThreshold);
+        const v_uint16 oneV = vx_setall_u16(1);
+        const v_uint16 widthV = vx_setall_u16((ushort)std::min(width, 0xFFFFu));
+        const v_uint16 heightV = vx_setall_u16((ushort)std::min(height, 0xFFFFu));
+
+        for (; x <= cols - lanes; x += lanes) {
+            v_uint8 error = vx_setzero_u8();
+            v_uint16 codes[2][2];
+            const uchar* const* planes[2] = { colRows, rowRows };
+            const int bits[2] = { colBits, rowBits };
+
+            // Gather one gray code bit per pattern pair, most significant bit first
+            for (int axis = 0; axis < 2; axis++) {
+                v_uint16 lo = vx_setzero_u16(), hi = vx_setzero_u16();
+                for (int k = 0; k < bits[axis]; k++) {
+                    v_uint8 pattern = vx_load(planes[axis][2 * k] + x);
+                    v_uint8 inverse = vx_load(planes[axis][2 * k + 1] + x);
+                    error = v_or(error, v_lt(v_absdiff(pattern, inverse), thresholdV));
+                    v_uint16 bitLo, bitHi;
+                    v_expand(v_gt(pattern, inverse), bitLo, bitHi);
+                    lo = v_or(v_shl<1>(lo), v_and(bitLo, oneV));
+                    hi = v_or(v_shl<1>(hi), v_and(bitHi, oneV));
+                }
+                // Gray to binary: every bit is the XOR of all more significant gray bits
+                lo = v_xor(lo, v_shr<1>(lo)); hi = v_xor(hi, v_shr<1>(hi));
+                lo = v_xor(lo, v_shr<2>(lo)); hi = v_xor(hi, v_shr<2>(hi));
+                lo = v_xor(lo, v_shr<4>(lo)); hi = v_xor(hi, v_shr<4>(hi));
+                lo = v_xor(lo, v_shr<8>(lo)); hi = v_xor(hi, v_shr<8>(hi));
+                codes[axis][0] = lo;
+                codes[axis][1] = hi;
+            }
+
+            // Decoded pixels outside the projector are flagged as well
+            error = v_or(error, v_pack(v_ge(codes[0][0], widthV), v_ge(codes[0][1], widthV)));
+            error = v_or(error, v_pack(v_ge(codes[1][0], heightV), v_ge(codes[1][1], heightV)));
+
+            ushort* coordPtr = (ushort*)(coordRow + x);
+            v_store_interleave(coordPtr, codes[0][0], codes[1][0]);
+            v_store_interleave(coordPtr + lanes, codes[0][1], codes[1][1]);
+            v_store(flagRow + x, error);
+        }
+    }
+#endif
+
+    // Scalar path for the remaining pixels
+    for (; x < cols; x++) {
+        bool error = false;
+        uint code[2] = { 0, 0 };
+        const uchar* const* planes[2] = { colRows, rowRows };
+        const int bits[2] = { colBits, rowBits };
+        for (int axis = 0; axis < 2; axis++) {
+            uint gray = 0;
+            for (int k = 0; k < bits[axis]; k++) {
+                int pattern = planes[axis][2 * k][x];
+                int inverse = planes[axis][2 * k + 1][x];
+                if ((uint)std::abs(pattern - inverse) < whiteThreshold) error = true;
+                gray = (gray << 1) | (pattern > inverse ? 1u : 0u);
+            }
+            gray ^= gray >> 1;
+            gray ^= gray >> 2;
+            gray ^= gray >> 4;
+            gray ^= gray >> 8;
+            code[axis] = gray;
+        }
+        if (code[0] >= width || code[1] >= height) error = true;
+
+        coordRow[x] = Vec2w((ushort)code[0], (ushort)code[1]);
+        flagRow[x] = error ? 255 : 0;
+    }
+}
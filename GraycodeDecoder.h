@@ -0,0 +1,59 @@
+//
+// Bit-plane graycode decoder, alternative to structured_light::GrayCodePattern::getProjPixel().
+//
+
+#ifndef CLIMBPM_GRAYCODEDECODER_H
+#define CLIMBPM_GRAYCODEDECODER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+// 2 * (16 + 16) pattern images for projectors of up to 65536 x 65536 pixels
+#define GRAYCODE_MAX_IMAGES 64
+
+using namespace cv;
+
+enum DecodeBackend {
+    // One structured_light::GrayCodePattern::getProjPixel() call per camera pixel
+    DECODE_OPENCV,
+    // Whole rows at once with GraycodeDecoder (SIMD where available)
+    DECODE_BITPLANE,
+    // GraycodeDecoder on tile corners only, interpolating the tiles in between; tiles where the samples
+    // disagree or the footprint ends are decoded fully
+    DECODE_PYRAMID
+};
+
+class GraycodeDecoder {
+public:
+    // Same parameters as the structured_light::GrayCodePattern the images were generated with
+    GraycodeDecoder(uint projWidth, uint projHeight, uint whiteThreshold);
+
+    // Number of captured images (pattern + inverse pairs, columns first) this decoder expects
+    size_t getImageCount() const { return 2 * (colBits + rowBits); }
+
+    // Decodes the rows [rowStart, rowEnd) of the captured pattern images.
+    // projCoords (CV_16UC2) receives the decoded projector pixel, flags (CV_8UC1) is set to 255 wherever
+    // getProjPixel() would have returned true for that camera pixel, so both backends classify pixels identically.
+    void decodeRows(const std::vector<Mat>& patternImages, int rowStart, int rowEnd, Mat& projCoords, Mat& flags) const;
+    // Decodes only the pixels [colStart, colEnd) of row y, the rest of the row is left untouched
+    void decodeSpan(const std::vector<Mat>& patternImages, int y, int colStart, int colEnd, Mat& projCoords, Mat& flags) const;
+    // Decodes area in square tiles of tileSize. Tiles completely inside mask are interpolated from their decoded
+    // corners if a decoded center sample confirms them within tolerance (projector pixels), tiles partially inside
+    // mask or failing that test are decoded fully, tiles outside mask are flagged. Returns the number of mask pixels
+    // in fully decoded tiles.
+    uint decodeTiles(const std::vector<Mat>& patternImages, const Mat& mask, Rect area, int tileSize, float tolerance,
+                     Mat& projCoords, Mat& flags) const;
+
+private:
+    uint width, height, whiteThreshold;
+    int colBits, rowBits;
+
+    void decodeRow(const uchar* const* rows, int cols, Vec2w* coordRow, uchar* flagRow) const;
+    // Decodes a single pixel, returns its flag
+    bool decodePixel(const std::vector<Mat>& patternImages, int x, int y, Vec2w& coord) const;
+    // Fills tile by interpolating its corners, returns false (leaving tile untouched) if the samples do not fit
+    bool interpolateTile(const std::vector<Mat>& patternImages, Rect tile, float tolerance, Mat& projCoords, Mat& flags) const;
+};
+
+
+#endif //CLIMBPM_GRAYCODEDECODER_H
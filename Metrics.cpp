@@ -0,0 +1,200 @@
+//
+// In-process metrics: stage timers, counters and duration histograms per projector, with optional Chrome trace export.
+//
+
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Names are literals, so two keys are equal when the text is, even if the pointers differ
+struct MetricKey {
+    const char* name;
+    int projector;
+    bool operator<(const MetricKey& other) const {
+        if (projector != other.projector) return projector < other.projector;
+        return std::strcmp(name, other.name) < 0;
+    }
+};
+
+struct TraceEvent {
+    const char* name;
+    int projector;
+    double startUs;
+    double durationUs;
+};
+
+std::atomic<bool> Metrics::enabledFlag(false);
+
+static std::mutex metricsMutex;
+static std::map<MetricKey, MetricsHistogram> histograms;
+static std::map<MetricKey, int64_t> counters;
+static bool tracingEnabled = false;
+static std::vector<TraceEvent> traceEvents;
+static uint64_t droppedTraceEvents = 0;
+// Trace timestamps are relative to program start
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+// ------------------------------------------------------------
+// ------------------------- HISTOGRAM ------------------------
+// ------------------------------------------------------------
+
+static double bucketUpperBound(int bucket) {
+    return METRICS_HISTOGRAM_MIN_MS * std::pow(2.0, bucket / 2.0);
+}
+
+void MetricsHistogram::add(double ms) {
+    int bucket = (ms > METRICS_HISTOGRAM_MIN_MS) ? (int)std::ceil(2.0 * std::log2(ms / METRICS_HISTOGRAM_MIN_MS)) : 0;
+    buckets[std::min(bucket, METRICS_HISTOGRAM_BUCKETS - 1)]++;
+    minMs = (count == 0) ? ms : std::min(minMs, ms);
+    maxMs = (count == 0) ? ms : std::max(maxMs, ms);
+    totalMs += ms;
+    count++;
+}
+
+double MetricsHistogram::percentile(double share) const {
+    if (count == 0) return 0.0;
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(share * count));
+    uint64_t cumulative = 0;
+    for (int bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++) {
+        cumulative += buckets[bucket];
+        if (cumulative >= target) return std::min(bucketUpperBound(bucket), maxMs);
+    }
+    return maxMs;
+}
+
+// ------------------------------------------------------------
+// ------------------------- RECORDING ------------------------
+// ------------------------------------------------------------
+
+void Metrics::setEnabled(bool enabled) {
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+void Metrics::setTracing(bool tracing) {
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    tracingEnabled = tracing;
+    // Reserved up front, so recording never allocates
+    if (tracing) traceEvents.reserve(METRICS_TRACE_CAPACITY);
+}
+
+void Metrics::recordDuration(const char* stage, int projector, double ms, bool trace) {
+    if (!isEnabled()) return;
+    double endUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceEpoch).count();
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    histograms[MetricKey{ stage, projector }].add(ms);
+    if (!trace || !tracingEnabled) return;
+    if (traceEvents.size() < METRICS_TRACE_CAPACITY)
+        traceEvents.push_back(TraceEvent{ stage, projector, endUs - ms * 1000.0, ms * 1000.0 });
+    else
+        droppedTraceEvents++;
+}
+
+void Metrics::count(const char* counter, int projector, int64_t value) {
+    if (!isEnabled()) return;
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    counters[MetricKey{ counter, projector }] += value;
+}
+
+void Metrics::reset() {
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    histograms.clear();
+    counters.clear();
+    traceEvents.clear();
+    droppedTraceEvents = 0;
+}
+
+// ------------------------------------------------------------
+// ------------------------- EXPORT ---------------------------
+// ------------------------------------------------------------
+
+void Metrics::report(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    os << std::left << std::setw(10) << "Projector" << std::setw(24) << "Stage" << std::right << std::setw(10) << "Count"
+       << std::setw(12) << "Mean ms" << std::setw(12) << "P50 ms" << std::setw(12) << "P95 ms" << std::setw(12) << "Max ms"
+       << std::endl;
+    for (const auto& entry : histograms) {
+        const MetricsHistogram& histogram = entry.second;
+        os << std::left << std::setw(10) << entry.first.projector << std::setw(24) << entry.first.name << std::right
+           << std::setw(10) << histogram.count << std::setw(12) << histogram.totalMs / histogram.count
+           << std::setw(12) << histogram.percentile(0.5) << std::setw(12) << histogram.percentile(0.95)
+           << std::setw(12) << histogram.maxMs << std::endl;
+    }
+    for (const auto& entry : counters)
+        os << std::left << std::setw(10) << entry.first.projector << std::setw(24) << entry.first.name << std::right
+           << std::setw(10) << entry.second << std::endl;
+}
+
+bool Metrics::writeJSON(const std::string& path) {
+    std::ofstream os(path);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    os << "{\n  \"stages\": [\n";
+    size_t i = 0;
+    for (const auto& entry : histograms) {
+        const MetricsHistogram& histogram = entry.second;
+        os << "    { \"stage\": \"" << entry.first.name << "\", \"projector\": " << entry.first.projector
+           << ", \"count\": " << histogram.count
+           << ", \"totalMs\": " << histogram.totalMs
+           << ", \"meanMs\": " << histogram.totalMs / histogram.count
+           << ", \"minMs\": " << histogram.minMs
+           << ", \"p50Ms\": " << histogram.percentile(0.5)
+           << ", \"p95Ms\": " << histogram.percentile(0.95)
+           << ", \"p99Ms\": " << histogram.percentile(0.99)
+           << ", \"maxMs\": " << histogram.maxMs << " }"
+           << (++i < histograms.size() ? "," : "") << "\n";
+    }
+    os << "  ],\n  \"counters\": [\n";
+    i = 0;
+    for (const auto& entry : counters) {
+        os << "    { \"counter\": \"" << entry.first.name << "\", \"projector\": " << entry.first.projector
+           << ", \"value\": " << entry.second << " }" << (++i < counters.size() ? "," : "") << "\n";
+    }
+    os << "  ],\n  \"droppedTraceEvents\": " << droppedTraceEvents << "\n}\n";
+    os.close();
+    return (bool)os;
+}
+
+bool Metrics::writeTrace(const std::string& path) {
+    std::ofstream os(path);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    // Name the track of every projector that has events
+    std::set<int> projectors;
+    for (const TraceEvent& event : traceEvents)
+        projectors.insert(event.projector);
+
+    os << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [\n";
+    bool first = true;
+    for (int projector : projectors) {
+        os << (first ? "" : ",\n") << "    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << projector
+           << ", \"args\": { \"name\": \"" << (projector > 0 ? "Projector " + std::to_string(projector) : std::string("Shared"))
+           << "\" } }";
+        first = false;
+    }
+    os << std::fixed << std::setprecision(3);
+    for (const TraceEvent& event : traceEvents) {
+        os << (first ? "" : ",\n") << "    { \"name\": \"" << event.name << "\", \"cat\": \"ClimbPM\", \"ph\": \"X\", \"ts\": "
+           << event.startUs << ", \"dur\": " << event.durationUs << ", \"pid\": 1, \"tid\": " << event.projector << " }";
+        first = false;
+    }
+    os << "\n  ]\n}\n";
+    os.close();
+    if (droppedTraceEvents > 0)
+        std::cerr << "Trace is missing " << droppedTraceEvents << " events beyond its capacity of "
+                  << METRICS_TRACE_CAPACITY << std::endl;
+    return (bool)os;
+}
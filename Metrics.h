@@ -0,0 +1,81 @@
+//
+// In-process metrics: stage timers, counters and duration histograms per projector, with optional Chrome trace export.
+//
+
+#ifndef CLIMBPM_METRICS_H
+#define CLIMBPM_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Histogram buckets are half octaves, starting below METRICS_HISTOGRAM_MIN_MS
+#define METRICS_HISTOGRAM_BUCKETS 40
+#define METRICS_HISTOGRAM_MIN_MS (1.0 / 64.0)
+// Trace events kept at most, later ones are dropped (memory is reserved when tracing is enabled)
+#define METRICS_TRACE_CAPACITY (1 << 18)
+
+// Distribution of the durations recorded for one stage of one projector
+struct MetricsHistogram {
+    uint64_t count;
+    double totalMs;
+    double minMs;
+    double maxMs;
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+    MetricsHistogram() : count(0), totalMs(0.0), minMs(0.0), maxMs(0.0), buckets() {}
+    void add(double ms);
+    // Upper bound of the bucket holding the given share (0..1) of the durations
+    double percentile(double share) const;
+};
+
+// Every function is a single relaxed atomic load while metrics are disabled (the default).
+// Stage and counter names have to be string literals, as they are kept by pointer.
+class Metrics {
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    // Additionally keeps every recorded duration as trace event (up to METRICS_TRACE_CAPACITY)
+    static void setTracing(bool tracing);
+
+    // Adds a duration that ends now to the stage's histogram, trace=false keeps it out of the trace
+    // (for intervals between events rather than work)
+    static void recordDuration(const char* stage, int projector, double ms, bool trace = true);
+    static void count(const char* counter, int projector, int64_t value = 1);
+    static void reset();
+
+    // Table of all stages and counters, sorted by projector (0 = not projector specific)
+    static void report(std::ostream& os);
+    static bool writeJSON(const std::string& path);
+    // Chrome trace event format (chrome://tracing, ui.perfetto.dev), one track per projector
+    static bool writeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+// Records the time from construction to destruction as duration of a stage
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* stage, int projector = 0)
+    : stage(stage), projector(projector), active(Metrics::isEnabled()) {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (active)
+            Metrics::recordDuration(stage, projector,
+                                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* stage;
+    int projector;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#endif //CLIMBPM_METRICS_H
@@ -5,113 +5,186 @@
 #include "ProjectorConfig.h"
 
 // --------- STATIC MEMBERS ---------------
-VideoCapture ProjectorConfig::camera;
+CameraGrabber ProjectorConfig::camera;
+Rig* ProjectorConfig::rig = nullptr;
+std::mutex ProjectorConfig::blendMutex;
+std::mutex ProjectorConfig::frameMutex;
+std::condition_variable ProjectorConfig::frameRequested;
+uint64_t ProjectorConfig::requestedFrame = 0;
 Mat ProjectorConfig::brightnessMap;
 uint ProjectorConfig::CAMWIDTH, ProjectorConfig::CAMHEIGHT;
-unsigned int ProjectorConfig::VAO;
-unsigned int ProjectorConfig::EBO;
-unsigned int ProjectorConfig::VBO;
-unsigned int ProjectorConfig::shader;
-GLuint ProjectorConfig::texture;
+SettleParams ProjectorConfig::settleParams;
+HomographyParams ProjectorConfig::homographyParams;
 
 // ------------------------------------------------------------
 // ------------ STATIC FUNCTIONS (PUBLIC) ---------------------
 // ------------------------------------------------------------
 
-bool ProjectorConfig::initGLFW() {
-    glfwSetErrorCallback(errorCallback);
-    if (!glfwInit())
-        return false;
-
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For macOS compatibility
-
-    return true;
+void ProjectorConfig::setRig(Rig* virtualRig) {
+    rig = virtualRig;
 }
 
-void ProjectorConfig::initCamera() {
-    camera = VideoCapture(0, CAP_DSHOW);
+void ProjectorConfig::initCamera(bool grayscale) {
+    camera.open(0, CAP_DSHOW, grayscale);
     assert(camera.isOpened());
-    auto testImg = getCameraImage();
-    CAMHEIGHT = testImg.rows;
-    CAMWIDTH = testImg.cols;
+    CAMHEIGHT = camera.getFrameSize().height;
+    CAMWIDTH = camera.getFrameSize().width;
 }
 
 void ProjectorConfig::computeContributions(ProjectorConfig *projectors, int count) {
-    // Initialize 2 dimensional arrays for contribution matrix
+    auto start = std::chrono::steady_clock::now();
+    // Initialize 2 dimensional arrays for contribution matrix, projectors without a C2P map (e.g. rejected decodes)
+    // contribute nothing
+    std::vector<char> calibrated(count);
     for (int i = 0; i < count; i++) {
-        projectors[i].contributionMatrix = Mat_<float>(CAMHEIGHT, CAMWIDTH);
+        calibrated[i] = !projectors[i].c2pValid.empty() && !projectors[i].white.empty();
+        if (calibrated[i]) {
+            projectors[i].contributionMatrix.create(CAMHEIGHT, CAMWIDTH, CV_32F);
+        } else {
+            std::cerr << "Projector " << projectors[i].params.id << " is not calibrated, it gets no contribution!" << std::endl;
+            projectors[i].contributionMatrix = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_32F);
+        }
     }
 
-    // CAREFUL! Looping over C2PList assumes they are all in the same order, CONFIRM THIS!! -> confirmed
-    for (int pxl = 0; pxl < projectors[0].c2pList.size(); pxl++) {
-        uint contributorsCount = 0;
-        uint whiteAcc = 0.0f;
-        Point pixel(projectors[0].c2pList[pxl].cx, projectors[0].c2pList[pxl].cy);
-        // Loop over all projectors and check if they contribute to the pixel
-        for (int i = 0; i < count; i++) {
-            if (projectors[i].c2pList[pxl].px + projectors[i].c2pList[pxl].py != 0) {
-                // This projector contributes to the camera pixel
-                whiteAcc += projectors[i].white.at<cv::uint8_t>(pixel.y, pixel.x);
+    // All c2p maps are indexed by camera pixel, so the same (x, y) refers to the same pixel for every projector.
+    // Rows are processed in parallel, the inner loops are branchless so the compiler vectorizes them.
+    parallel_for_(Range(0, CAMHEIGHT), [&](const Range& rows) {
+        std::vector<float> whiteAcc(CAMWIDTH);
+        for (int y = rows.start; y < rows.end; y++) {
+            // Sum up the white level of all projectors contributing to each pixel
+            std::fill(whiteAcc.begin(), whiteAcc.end(), 0.0f);
+            float* acc = whiteAcc.data();
+            for (int i = 0; i < count; i++) {
+                if (!calibrated[i]) continue;
+                const uchar* validRow = projectors[i].c2pValid.ptr<uchar>(y);
+                const uchar* whiteRow = projectors[i].white.ptr<uchar>(y);
+                for (int x = 0; x < CAMWIDTH; x++)
+                    acc[x] += validRow[x] ? (float)whiteRow[x] : 0.0f;
             }
-        }
 
-        // Loop over all projectors and set the pixel's contribution value
-        for (int i = 0; i < count; i++) {
-            float contribution = 0.0f;
-            if ((whiteAcc > 0) && (projectors[i].c2pList[pxl].px + projectors[i].c2pList[pxl].py != 0)) {
-                contribution = float(projectors[i].white.at<cv::uint8_t>(pixel.y, pixel.x)) / whiteAcc;
+            // Each projector's share of that sum, white levels are integers, so a non-zero sum is at least 1
+            for (int i = 0; i < count; i++) {
+                if (!calibrated[i]) continue;
+                const uchar* validRow = projectors[i].c2pValid.ptr<uchar>(y);
+                const uchar* whiteRow = projectors[i].white.ptr<uchar>(y);
+                float* contributionRow = projectors[i].contributionMatrix.ptr<float>(y);
+                for (int x = 0; x < CAMWIDTH; x++) {
+                    float share = (float)whiteRow[x] / std::max(acc[x], 1.0f);
+                    contributionRow[x] = validRow[x] ? share : 0.0f;
+                }
             }
-            projectors[i].contributionMatrix.at<float>(pixel.y, pixel.x) = contribution;
         }
-    }
+    });
+    double contributionMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Contributions of " << count << " projectors computed in " << contributionMs << " ms" << std::endl;
 
-    // Save visualizations
+    // Save visualizations and move the contributions into projector space
     for (int i = 0; i < count; i++) {
         Mat viz;
         projectors[i].contributionMatrix.convertTo(viz, CV_8UC1, 255.0);
         imwrite("captured" + std::to_string(projectors[i].params.id) + "/contribution.png", viz);
+        if (calibrated[i]) projectors[i].computeBlendMap();
     }
 }
 
-void ProjectorConfig::projectImage(ProjectorConfig* projectors, uint count, const Mat& img) {
-    bool shouldClose = false;
-    // The static way, warp images for each projector beforehand
-    Mat* images = new Mat[count];
+void ProjectorConfig::calibrateMultiplexed(ProjectorConfig *projectors, int count) {
+    for (int i = 0; i < count; i++)
+        projectors[i].generateGraycodes();
+
+    if (rig == nullptr && !camera.isOpened())
+        initCamera();
+
+    std::vector<Mat> footprints = probeFootprints(projectors, count);
+
+    // Greedily assign each projector to the first group it does not overlap with
+    std::vector<std::vector<int>> groups;
     for (int i = 0; i < count; i++) {
-        images[i] = projectors[i].warpImage(img, true);
+        bool assigned = false;
+        for (auto& group : groups) {
+            bool fits = true;
+            for (int j : group) {
+                fits = fits && projectors[i].graycodes.size() == projectors[j].graycodes.size()
+                       && countNonZero(footprints[i] & footprints[j]) == 0;
+            }
+            if (fits) {
+                group.push_back(i);
+                assigned = true;
+                break;
+            }
+        }
+        if (!assigned) groups.push_back({ i });
     }
-    while (!shouldClose) {
+    std::cout << "Calibrating " << count << " projectors in " << groups.size() << " graycode sequences." << std::endl;
+
+    Mat black = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
+    for (const auto& group : groups) {
+        std::vector<ProjectorConfig*> members;
+        std::vector<Mat> memberFootprints;
+        std::cout << "Capturing projectors";
+        for (int i : group) {
+            members.push_back(&projectors[i]);
+            memberFootprints.push_back(footprints[i]);
+            std::cout << " " << projectors[i].params.id;
+        }
+        std::cout << " ..." << std::endl;
+
+        // Projectors of other groups show black
         for (int i = 0; i < count; i++) {
-            projectors[i].projectImage(images[i], false);
-            if (projectors[i].wantsToClose()) shouldClose = true;
+            if (std::find(group.begin(), group.end(), i) == group.end())
+                projectors[i].showPattern(black);
         }
+        captureGraycodes(members, memberFootprints);
+        for (ProjectorConfig* member : members)
+            member->decodeGraycode();
     }
-    delete[] images;
 }
 
-void ProjectorConfig::computeBrightnessMap(ProjectorConfig *projectors, int count) {
-    // Capture image with white from all projectors
-    cv::Mat whiteImg = cv::Mat(CAMHEIGHT, CAMWIDTH, CV_8UC3, cv::Scalar(255, 255, 255));
+void ProjectorConfig::correctDrift(ProjectorConfig* projectors, int count) {
+    if (rig == nullptr && !camera.isOpened())
+        initCamera();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+        projectors[i].showPattern(Mat::zeros(projectors[i].params.height, projectors[i].params.width, CV_8UC1));
+    double changeMs, settleMs;
+    Mat black;
+    captureSettledFrame(Mat(), 0.0, black, changeMs, settleMs);
+
+    // Same dot grid for every projector, one projector at a time
+    std::vector<int> failed;
+    bool blended = false;
+    Mat previous = black;
     for (int i = 0; i < count; i++) {
-        projectors[i].projectImage(whiteImg, false);
+        ProjectorConfig& projector = projectors[i];
+        blended = blended || !projector.contributionMatrix.empty();
+        Mat markers = Mat::zeros(projector.params.height, projector.params.width, CV_8UC1);
+        for (const Point2f& center : projector.driftMarkerCenters())
+            circle(markers, center, DRIFT_MARKER_RADIUS, Scalar(255), FILLED, LINE_AA);
+        projector.showPattern(markers);
+        Mat lit;
+        captureSettledFrame(previous, 0.0, lit, changeMs, settleMs);
+        projector.showPattern(Mat::zeros(projector.params.height, projector.params.width, CV_8UC1));
+        previous = lit;
+
+        Mat correction;
+        if (projector.estimateDrift(black, lit, correction))
+            projector.applyDriftCorrection(correction);
+        else
+            failed.push_back(i);
     }
-    waitKey(5000);
-    auto whiteCaptured = getCameraImage(); // for some reason needs to be "flushed" once
-    whiteCaptured = getCameraImage();
-    imshow("White Maximum All Projectors", whiteCaptured);
-    waitKey(0);
-    Mat grayScale;
-    cvtColor(whiteCaptured, grayScale, COLOR_BGR2GRAY);
-    imwrite("BrightnessMap/grayscale.png", grayScale);
-    // Apply low-pass filter to get the map above specified brightness
-    const uint MIN_BRIGHTNESS = 150;
-    Mat filtered;
-    threshold(grayScale, filtered, MIN_BRIGHTNESS, 255, THRESH_TOZERO);
-    imwrite("BrightnessMap/filtered.png", filtered);
-    brightnessMap = filtered;
+    double driftMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Drift of " << count - failed.size() << " of " << count << " projectors corrected in " << driftMs
+              << " ms" << std::endl;
+
+    // The other projectors still show black, as a full calibration expects
+    for (int i : failed) {
+        std::cout << "Recalibrating projector " << projectors[i].params.id << " ..." << std::endl;
+        projectors[i].generateGraycodes();
+        projectors[i].captureGraycodes();
+        projectors[i].decodeGraycode();
+    }
+    if (blended)
+        computeContributions(projectors, count);
 }
 
 // ------------------------------------------------------------
@@ -145,21 +218,186 @@ void ProjectorConfig::getProjectionBoundaries(int count, int &minX, int &minY, i
     }
 }
 
-void ProjectorConfig::errorCallback(int error, const char* description) {
-    std::cerr << "GLFW Error (" << error << "): " << description << std::endl;
+Mat ProjectorConfig::getCameraImage() {
+    CameraFrame frame;
+    getCameraFrame(frame);
+    return frame.image;
 }
 
-void ProjectorConfig::keyCallback(GLFWwindow *window, int key, int scandone, int action, int mods) {
-    if (action != GLFW_PRESS) return;
+bool ProjectorConfig::getCameraFrame(CameraFrame& frame) {
+    if (rig != nullptr) {
+        frame.timestamp = std::chrono::steady_clock::now();
+        frame.image = rig->captureFrame();
+        return !frame.image.empty();
+    }
+    // Frames grabbed before the call may still show what was projected before
+    ScopedTimer timer("cameraWait");
+    if (!camera.frameAfter(std::chrono::steady_clock::now(), frame)) {
+        std::cerr << "No camera frame within " << CAMERA_TIMEOUT_MS << " ms!" << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    if (key == GLFW_KEY_ESCAPE)
-        glfwSetWindowShouldClose(window, GLFW_TRUE);
+bool ProjectorConfig::captureSettledFrame(const Mat& previous, double maxChangeMs, Mat& settled, double& changeMs, double& settleMs) {
+    ScopedTimer timer("capture");
+    auto start = std::chrono::steady_clock::now();
+    // Frames are compared downscaled, which is cheaper and averages out sensor noise
+    const double scale = 0.25;
+    Mat previousSmall, lastSmall, difference;
+    if (!previous.empty())
+        resize(previous, previousSmall, Size(), scale, scale, INTER_AREA);
+
+    // Without a previous frame there is no change to wait for
+    bool changed = previous.empty();
+    changeMs = 0.0;
+    uint stableCount = 0;
+    while (true) {
+        // Keeps the pattern window responsive
+        if (rig == nullptr) waitKey(1);
+        Mat gray, small;
+        Mat frame = getCameraImage();
+        if (frame.channels() == 1)
+            gray = frame;
+        else
+            cvtColor(frame, gray, COLOR_BGR2GRAY);
+        resize(gray, small, Size(), scale, scale, INTER_AREA);
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!changed) {
+            // Stale frames still show the previous pattern. A change confined to a small area hardly moves the mean,
+            // so an area that clearly changed counts as well.
+            absdiff(small, previousSmall, difference);
+            changed = sum(difference)[0] / small.total() > settleParams.changeThreshold
+                      || countNonZero(difference > settleParams.areaThreshold) > settleParams.areaMinShare * small.total();
+            // Patterns too fine for the camera barely differ from their predecessor, accept them once they
+            // had twice as long to appear as any earlier pattern needed
+            if (!changed && maxChangeMs > 0.0 && elapsedMs > 2.0 * maxChangeMs)
+                changed = true;
+            if (changed) changeMs = elapsedMs;
+        } else if (!lastSmall.empty()) {
+            double difference = norm(small, lastSmall, NORM_L1) / small.total();
+            stableCount = (difference < settleParams.noiseFloor) ? stableCount + 1 : 0;
+        }
+        lastSmall = small;
+        settled = gray;
+        settleMs = elapsedMs;
+
+        if (changed && stableCount >= settleParams.stableFrames) return true;
+        if (elapsedMs > settleParams.timeoutMs) return false;
+    }
 }
 
-Mat ProjectorConfig::getCameraImage() {
-    Mat image;
-    camera.read(image);
-    return image.clone();
+void ProjectorConfig::captureGraycodes(const std::vector<ProjectorConfig*>& group, const std::vector<Mat>& footprints) {
+    if (rig == nullptr && !camera.isOpened())
+        initCamera();
+
+    // Show white image first, real setups are checked in the camera preview until a key is pressed
+    for (ProjectorConfig* projector : group)
+        projector->showPattern(projector->graycodes.back());
+    // The preview shows the newest frame without waiting for the camera, so keys are handled right away
+    uint64_t shownSequence = 0;
+    while (rig == nullptr) {
+        CameraFrame frame;
+        if (camera.latestFrame(frame) && frame.sequence != shownSequence) {
+            imshow("camera", frame.image);
+            shownSequence = frame.sequence;
+        }
+        if (waitKey(1) != -1) break;
+    }
+
+    // PNG encoding happens on background threads, so only projection and camera latency set the capture pace
+    const size_t imageCount = group.front()->graycodes.size();
+    const uint writerThreads = std::max(2u, std::thread::hardware_concurrency() / 2);
+    AsyncImageWriter writer(writerThreads, writerThreads * CAPTURE_WRITE_QUEUE_PER_THREAD);
+    for (ProjectorConfig* projector : group) {
+        fs::create_directory("captured" + std::to_string(projector->params.id));
+        projector->captured = std::vector<Mat>();
+    }
+
+    // Layout expected by decodeGraycode(): cam_00 is the white image that is already shown,
+    // followed by all patterns in order, the last one being black
+    auto captureStart = std::chrono::steady_clock::now();
+    double maxChangeMs = 0.0;
+    uint timeoutCount = 0;
+    Mat previous;
+    for (int i = 0; i < imageCount; i++) {
+        // Display the graycode
+        if (i > 0) {
+            for (ProjectorConfig* projector : group)
+                projector->showPattern(projector->graycodes[i - 1]);
+        }
+
+        Mat grayImg;
+        double changeMs, settleMs;
+        bool settled = captureSettledFrame(previous, maxChangeMs, grayImg, changeMs, settleMs);
+        maxChangeMs = std::max(maxChangeMs, changeMs);
+        previous = grayImg;
+        if (settled) {
+            std::cout << "\tCapture " << i << " settled after " << settleMs << " ms (changed after " << changeMs << " ms)" << std::endl;
+        } else {
+            timeoutCount++;
+            // The frame is shared by the group, so every member failed to settle
+            for (ProjectorConfig* projector : group)
+                Metrics::count("captureTimeouts", projector->params.id);
+            std::cerr << "\tCapture " << i << " did not settle within " << settleParams.timeoutMs << " ms, using latest frame" << std::endl;
+        }
+
+        std::ostringstream oss;
+        oss << std::setfill('0') << std::setw(2) << i;
+        for (size_t p = 0; p < group.size(); p++) {
+            // Multiplexed projectors only keep the light inside their own footprint
+            Mat projectorImg = grayImg;
+            if (!footprints.empty()) {
+                projectorImg = Mat::zeros(grayImg.size(), grayImg.type());
+                grayImg.copyTo(projectorImg, footprints[p]);
+            }
+            // Save to img array
+            group[p]->captured.push_back(projectorImg);
+            // Save to disk (shares the pixel data with the captured image)
+            writer.write("captured" + std::to_string(group[p]->params.id) + "/cam_" + oss.str() + ".png", std::move(projectorImg));
+        }
+    }
+    double captureMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - captureStart).count();
+    std::cout << "Captured " << imageCount << " images in " << captureMs / 1000.0 << " s ("
+              << timeoutCount << " timeouts)." << std::endl;
+
+    if (!writer.flush())
+        std::cerr << "Error saving image!" << std::endl;
+}
+
+std::vector<Mat> ProjectorConfig::probeFootprints(ProjectorConfig* projectors, int count) {
+    Mat black = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC1);
+    Mat white(CAMHEIGHT, CAMWIDTH, CV_8UC1, Scalar(255));
+    for (int i = 0; i < count; i++)
+        projectors[i].showPattern(black);
+
+    double changeMs, settleMs;
+    Mat allBlack;
+    captureSettledFrame(Mat(), 0.0, allBlack, changeMs, settleMs);
+
+    std::vector<Mat> footprints;
+    Mat previous = allBlack;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < count; j++)
+            projectors[j].showPattern((i == j) ? white : black);
+        Mat lit;
+        captureSettledFrame(previous, 0.0, lit, changeMs, settleMs);
+        previous = lit;
+
+        // Everything noticeably brighter than with all projectors black, without speckles and with a safety margin
+        Mat footprint;
+        threshold(lit - allBlack, footprint, FOOTPRINT_THRESHOLD, 255, THRESH_BINARY);
+        morphologyEx(footprint, footprint, MORPH_OPEN, getStructuringElement(MORPH_RECT, Size(5, 5)));
+        dilate(footprint, footprint, getStructuringElement(MORPH_RECT, Size(2 * FOOTPRINT_MARGIN + 1, 2 * FOOTPRINT_MARGIN + 1)));
+        std::cout << "\tProjector " << projectors[i].params.id << " covers " << (float)countNonZero(footprint) / footprint.total() * 100.0f
+                  << " % of the camera image." << std::endl;
+        footprints.push_back(footprint);
+    }
+
+    for (int i = 0; i < count; i++)
+        projectors[i].showPattern(black);
+    return footprints;
 }
 
 // ------------------------------------------------------------
@@ -187,43 +425,7 @@ void ProjectorConfig::generateGraycodes() {
 }
 
 void ProjectorConfig::captureGraycodes() {
-    namedWindow("Pattern", WINDOW_NORMAL);
-    resizeWindow("Pattern", params.width, params.height);
-    moveWindow("Pattern", params.posX, params.posY);
-    setWindowProperty("Pattern", WND_PROP_FULLSCREEN, WINDOW_FULLSCREEN);
-
-    if (!camera.isOpened())
-        initCamera();
-
-    // Show white image first
-    imshow("Pattern", graycodes[graycodes.size() - 1]);
-    while (true) {
-        Mat img = getCameraImage();
-        imshow("camera", img);
-        if (waitKey(1) != -1) break;
-    }
-
-    fs::create_directory("captured" + std::to_string(params.id));
-    for (int i = 0; i < graycodes.size(); i++) {
-        // Display the graycode
-        Mat& gimg = graycodes[i];
-        imshow("Pattern", gimg);
-        waitKey(PATTERN_DELAY);
-
-        Mat img = getCameraImage();
-        // Convert to grayscale
-        Mat grayImg;
-        cvtColor(img, grayImg, COLOR_BGR2GRAY);
-
-        // Save to disk
-        std::ostringstream oss;
-        oss << std::setfill('0') << std::setw(2) << i;
-        if (!imwrite("captured" + std::to_string(params.id) + "/cam_" + oss.str() + ".png", grayImg))
-            std::cerr << "Error saving image!" << std::endl;
-
-        // Save to img array
-        captured.push_back(grayImg);
-    }
+    captureGraycodes({ this }, std::vector<Mat>());
 }
 
 void ProjectorConfig::loadGraycodes() {
@@ -249,7 +451,23 @@ void ProjectorConfig::loadGraycodes() {
     white = captured.front();
 }
 
-Mat ProjectorConfig::decodeGraycode() {
+Mat ProjectorConfig::decodeGraycode(DecodeBackend backend) {
+    ScopedTimer timer("decode", params.id);
+    if (backend == DECODE_OPENCV && pattern.empty()) {
+        std::cerr << "Tried decoding graycodes before pattern was initialized! Make sure to call generateGraycodes() before decodeGraycode()!" << std::endl;
+        return Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3); // empty
+    }
+
+    // Checked before the captures are consumed, so that a rejected call leaves them untouched.
+    // White and black are captured in addition to the patterns.
+    GraycodeDecoder decoder(params.width, params.height, WHITETHRESHOLD);
+    size_t patternCount = (backend == DECODE_OPENCV) ? pattern->getNumberOfPatternImages() : decoder.getImageCount();
+    if (captured.size() != patternCount + 2) {
+        std::cerr << "Expected " << patternCount + 2 << " graycode captures for a " << params.width << " x "
+                  << params.height << " projector, but got " << captured.size() << "!" << std::endl;
+        return Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
+    }
+
     // Load the black and white captures from their predefined positions
     white = captured.front();
     captured.erase(captured.begin());
@@ -262,76 +480,128 @@ Mat ProjectorConfig::decodeGraycode() {
     // Stores the amount of light that reaches each pixel, that is not coming from this projectors light
     Mat litByOthers = black - whiteThresholded;
 
-    for (auto & i : captured) {
-        i = i - litByOthers;
-    }
     imwrite("captured" + std::to_string(params.id) + "/litByOthers.png", litByOthers);
 
+    // Only pixels this projector lights and no other light reaches can be mapped, so decoding is limited to the
+    // span between the first and last such pixel of every row
+    // (white values are checked for very bright pixels, as they would falsely be discarded by the black/white test)
+    Mat thresholdPassed = (white >= 250) | ((white - black) > BLACKTHRESHOLD);
+    Mat ambientLit = litByOthers > 0;
+    Mat footprint = thresholdPassed & ~ambientLit;
+    Rect roi = boundingRect(footprint);
+    std::vector<Vec2i> spans(CAMHEIGHT, Vec2i(0, 0));
+    for (int y = roi.y; y < roi.y + roi.height; y++) {
+        const uchar* footprintRow = footprint.ptr<uchar>(y);
+        int xStart = roi.x, xEnd = roi.x + roi.width;
+        while (xStart < xEnd && !footprintRow[xStart]) xStart++;
+        while (xEnd > xStart && !footprintRow[xEnd - 1]) xEnd--;
+        spans[y] = Vec2i(xStart, xEnd);
+    }
+
+    // Patterns are only read inside the footprint's bounding box
+    for (Mat& image : captured) {
+        Mat region = image(roi);
+        subtract(region, litByOthers(roi), region);
+    }
+
     Mat viz = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
-    c2pList = std::vector<C2P>();
 
-    // Decode each pixel
-    uint pxlCount = 0, thresholdFailCount = 0, projPxlCount = 0, mappedPxlCount = 0, ambientCount = 0;
-    for (int y = 0; y < CAMHEIGHT; y++) {
-        for (int x = 0; x < CAMWIDTH; x++) {
-            cv::Point pixel;
-            pxlCount++;
-            bool ambientLit = litByOthers.at<cv::uint8_t>(y, x) > 0;
-            if (ambientLit) ambientCount++;
-            auto whiteValue = white.at<cv::uint8_t>(y, x);
-            // Check white value for very bright pixels, as they would falsely be discarded by this check
-            bool thresholdPassed = (whiteValue >= 250) || (whiteValue - black.at<cv::uint8_t>(y, x) >
-                                   BLACKTHRESHOLD);
-            if (!thresholdPassed) thresholdFailCount++;
-            try {
-                bool projPixel = pattern->getProjPixel(captured, x, y, pixel);
-                if (projPixel) projPxlCount++;
-                if (!ambientLit && thresholdPassed && projPixel)
-                {
-                    mappedPxlCount++;
-                    viz.at<cv::Vec3b>(y,x)[0] = ((float) pixel.x / params.width) * 255;
-                    viz.at<cv::Vec3b>(y,x)[1] = ((float) pixel.y / params.height) * 255;
-                }
+    // Decoded projector pixel and getProjPixel() result of every camera pixel
+    Mat projCoords(CAMHEIGHT, CAMWIDTH, CV_16UC2);
+    Mat projFlags(CAMHEIGHT, CAMWIDTH, CV_8UC1);
+
+    // Decode the footprint's rows in parallel tiles, each tile keeps its own counters which are reduced afterwards.
+    // The pyramid decode works on square tiles, so its row tiles are exactly one square high.
+    const int rowsPerTile = (backend == DECODE_PYRAMID) ? PYRAMID_TILE_SIZE : 8;
+    const int tileCount = (roi.height + rowsPerTile - 1) / rowsPerTile;
+    std::vector<DecodeStats> tileStats(tileCount);
+    auto decodeStart = std::chrono::steady_clock::now();
+    parallel_for_(Range(0, tileCount), [&](const Range& range) {
+        for (int tile = range.start; tile < range.end; tile++) {
+            DecodeStats& stats = tileStats[tile];
+            int yStart = roi.y + tile * rowsPerTile;
+            int yEnd = std::min(yStart + rowsPerTile, roi.y + roi.height);
+            if (backend == DECODE_PYRAMID) {
+                stats.refinedPxlCount += decoder.decodeTiles(captured, footprint, Rect(roi.x, yStart, roi.width, yEnd - yStart),
+                                                             PYRAMID_TILE_SIZE, PYRAMID_TOLERANCE, projCoords, projFlags);
             }
-            catch (Exception e) {
-                std::cerr << "Tried decoding graycodes before pattern was initialized! Make sure to call generateGraycodes() before decodeGraycode()!" << std::endl;
-                return viz; // empty
+            for (int y = yStart; y < yEnd; y++) {
+                const int xStart = spans[y][0], xEnd = spans[y][1];
+                if (xStart == xEnd) continue;
+                stats.decodedPxlCount += xEnd - xStart;
+                Vec2w* coordRow = projCoords.ptr<Vec2w>(y);
+                uchar* flagRow = projFlags.ptr<uchar>(y);
+                if (backend == DECODE_BITPLANE) {
+                    decoder.decodeSpan(captured, y, xStart, xEnd, projCoords, projFlags);
+                } else if (backend == DECODE_OPENCV) {
+                    for (int x = xStart; x < xEnd; x++) {
+                        cv::Point pixel;
+                        flagRow[x] = pattern->getProjPixel(captured, x, y, pixel) ? 255 : 0;
+                        coordRow[x] = Vec2w(pixel.x, pixel.y);
+                    }
+                }
+
+                const uchar* footprintRow = footprint.ptr<uchar>(y);
+                Vec3b* vizRow = viz.ptr<Vec3b>(y);
+                for (int x = xStart; x < xEnd; x++) {
+                    bool projPixel = flagRow[x] != 0;
+                    if (projPixel) stats.projPxlCount++;
+                    if (footprintRow[x] && projPixel)
+                    {
+                        stats.mappedPxlCount++;
+                        vizRow[x][0] = ((float) coordRow[x][0] / params.width) * 255;
+                        vizRow[x][1] = ((float) coordRow[x][1] / params.height) * 255;
+                    }
+                }
             }
         }
+    });
+    DecodeStats stats;
+    for (const DecodeStats& t : tileStats) stats += t;
+    double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+    // The footprint pre-pass already classified every pixel
+    stats.pxlCount = CAMWIDTH * CAMHEIGHT;
+    stats.ambientCount = countNonZero(ambientLit);
+    stats.thresholdFailCount = stats.pxlCount - countNonZero(thresholdPassed);
+    Metrics::count("decodedPixels", params.id, stats.decodedPxlCount);
+    Metrics::count("ambientPixels", params.id, stats.ambientCount);
+    Metrics::count("thresholdFailedPixels", params.id, stats.thresholdFailCount);
+    Metrics::count("unmappedPixels", params.id, stats.decodedPxlCount - stats.projPxlCount);
+    Metrics::count("mappedPixels", params.id, stats.mappedPxlCount);
+    std::cout << "\t\tDecoded " << stats.decodedPxlCount << " of " << stats.pxlCount << " pixels (footprint " << roi.width
+              << " x " << roi.height << " at " << roi.x << ", " << roi.y << ") in " << decodeMs << " ms on "
+              << getNumThreads() << " threads (" << (backend == DECODE_BITPLANE ? "bit-plane" : backend == DECODE_PYRAMID ? "pyramid" : "OpenCV")
+              << " backend)." << std::endl;
+    if (backend == DECODE_PYRAMID) {
+        // Tiles are decided on footprint pixels, the spans also hold the gaps between them
+        int footprintPxlCount = countNonZero(footprint);
+        Metrics::count("refinedPixels", params.id, stats.refinedPxlCount);
+        std::cout << "\t\tRefined " << stats.refinedPxlCount << " of " << footprintPxlCount << " footprint pixels at full resolution ("
+                  << (footprintPxlCount > 0 ? (float)stats.refinedPxlCount / footprintPxlCount * 100.0f : 0.0f)
+                  << " %), the rest was interpolated." << std::endl;
     }
-    std::cout << "\t\tAmbient Light test failed for " << ambientCount << " of " << pxlCount <<
-              " pixels (" << (float)ambientCount / pxlCount * 100.0f << " %)." << std::endl;
+    std::cout << "\t\tAmbient Light test failed for " << stats.ambientCount << " of " << stats.pxlCount <<
+              " pixels (" << (float)stats.ambientCount / stats.pxlCount * 100.0f << " %)." << std::endl;
 
-    std::cout << "\t\tThreshold failed for " << thresholdFailCount << " of " << pxlCount <<
-              " pixels (" << (float)thresholdFailCount / pxlCount * 100.0f << " %)." << std::endl;
+    std::cout << "\t\tThreshold failed for " << stats.thresholdFailCount << " of " << stats.pxlCount <<
+              " pixels (" << (float)stats.thresholdFailCount / stats.pxlCount * 100.0f << " %)." << std::endl;
 
-    std::cout << "\t\tNo mapping retrieved for " << pxlCount - projPxlCount << " of " << pxlCount <<
-              " pixels (" << (float)(pxlCount - projPxlCount) / pxlCount * 100.0f << " %)." << std::endl;
+    std::cout << "\t\tNo mapping retrieved for " << stats.decodedPxlCount - stats.projPxlCount << " of " << stats.decodedPxlCount <<
+              " decoded pixels (" << (stats.decodedPxlCount > 0 ? (float)(stats.decodedPxlCount - stats.projPxlCount) / stats.decodedPxlCount * 100.0f : 0.0f)
+              << " %)." << std::endl;
 
-    std::cout << "\t\t" << mappedPxlCount << " of " << pxlCount <<
-              " pixels (" << (float)(mappedPxlCount) / pxlCount * 100.0f << " %) were successfully mapped." << std::endl;
+    std::cout << "\t\t" << stats.mappedPxlCount << " of " << stats.pxlCount <<
+              " pixels (" << (float)(stats.mappedPxlCount) / stats.pxlCount * 100.0f << " %) were successfully mapped." << std::endl;
 
     // DENOISE THE IMAGE BEFORE CONVERTING IT TO C2P COORDINATES
     //imwrite("captured" + std::to_string(params.id) + "/noisy.png", viz);
     viz = reduceCalibrationNoise(viz);
     //imwrite("captured" + std::to_string(params.id) + "/denoised.png", viz);
 
-    for (int y = 0; y < CAMHEIGHT; y++) {
-        for (int x = 0; x < CAMWIDTH; x++) {
-            int px = viz.at<Vec3b>(y,x)[0];
-            int py = viz.at<Vec3b>(y,x)[1];
-            px = ((float)px / 255) * params.width;
-            py = ((float)py / 255) * params.height;
-            c2pList.push_back(C2P(x, y, px, py));
-        }
-    }
+    c2pFromVisualization(viz);
 
     // Save C2P as file
-    std::ofstream os("captured" + std::to_string(params.id) + "/c2p.csv");
-    for (C2P elem : c2pList) {
-        os << elem.cx << ", " << elem.cy << ", " << elem.px << ", " << elem.py << std::endl;
-    }
-    os.close();
+    saveC2Plist();
     // Save result image
     if (!imwrite("captured" + std::to_string(params.id) + "/result.png", viz))
         std::cerr << "Error saving result image!" << std::endl;
@@ -340,59 +610,60 @@ Mat ProjectorConfig::decodeGraycode() {
 }
 
 Mat ProjectorConfig::getHomography() {
-    if (homography.empty())
-        computeHomography();
+    // Fitting takes a while, so the homography of the last launch is kept next to the calibration.
+    // A failed fit is only retried once the calibration changes.
+    if (homography.empty() && !homographyFailed) {
+        std::string path = "captured" + std::to_string(params.id) + "/homography.bin";
+        if (!WarpMapFile::readHomography(path, computeHomographyKey(), homography)) {
+            computeHomography();
+            if (!homography.empty()) WarpMapFile::writeHomography(path, computeHomographyKey(), homography);
+        }
+        homographyFailed = homography.empty();
+    }
     return homography;
 }
 
-Mat ProjectorConfig::warpImage(Mat img, bool save) {
-    Size resolution(params.width, params.height);
+Mat ProjectorConfig::warpImage(const Mat& img, bool save) {
     Mat warpedImage;
-    // Flip horizontally
-    flip(img, warpedImage, 1);
-    // Apply intensity according to each projector pixel's contribution
-    //Mat intensityCorrectedImage;
-    //applyContributionMatrix(warpedImage, intensityCorrectedImage);
-    // Warp from camera space to projector space using the homography matrix
-    warpPerspective(warpedImage, warpedImage, getHomography(), resolution);
+    warpImage(img, warpedImage);
 
     // Optionally save warping steps results
     if (save) {
         std::string path = "RenderTests/Projector" + std::to_string(params.id);
-        //imwrite(path + "contribution.png", intensityCorrectedImage);
         imwrite(path + "result.png", warpedImage);
     }
 
     return warpedImage;
 }
 
-void ProjectorConfig::projectImage(Mat img, bool warp) {
-    Mat warpedImage = img.clone();
-
-    if (warp) {
-        warpedImage = warpImage(img);
+void ProjectorConfig::warpImage(const Mat& img, Mat& warped) {
+    auto start = std::chrono::steady_clock::now();
+    // Sample positions (flip and homography or lookup table) are only computed when the calibration changes
+    bool warm = updateWarpMap(img.size());
+
+    // Warp from camera space to projector space (contributions are applied while drawing)
+    if (warpMap1.empty()) {
+        warped.create((int)params.height, (int)params.width, img.type());
+        warped.setTo(Scalar::all(0));
+    } else {
+        remap(img, warped, warpMap1, warpMap2, INTER_LINEAR, BORDER_CONSTANT);
     }
 
-    // Flip vertically
-    flip(warpedImage, warpedImage, 0);
-
-    // Create projector window
-    glfwMakeContextCurrent(window);
-
-    // Upload the image to the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, warpedImage.cols, warpedImage.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, warpedImage.ptr());
-    // Render
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(shader);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    recordWarpTime(warm, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
 
-    // Swap front and back buffers
-    glfwSwapBuffers(window);
-    glfwPollEvents();
-    // Queried by managing application
-    shouldClose = glfwWindowShouldClose(window);
+Mat ProjectorConfig::warpToBuffer(const Mat& img) {
+    // A buffer only held here is neither queued, pending nor being uploaded, and nothing else can take it meanwhile
+    for (uint i = 0; i < WARP_BUFFER_COUNT; i++) {
+        Mat& buffer = warpBuffers[(warpBufferIndex + i) % WARP_BUFFER_COUNT];
+        if (buffer.u != nullptr && buffer.u->refcount > 1) continue;
+        warpBufferIndex = (warpBufferIndex + i + 1) % WARP_BUFFER_COUNT;
+        warpImage(img, buffer);
+        return buffer;
+    }
+    Mat warped;
+    warpImage(img, warped);
+    return warped;
 }
 
 void ProjectorConfig::visualizeContribution() {
@@ -409,78 +680,128 @@ void ProjectorConfig::loadConfiguration() {
     //loadContribution();
 }
 
-void ProjectorConfig::applyAreaMask() {
+void ProjectorConfig::applyAreaMask(bool preview) {
     Mat mask = computeProjectorAreaMask(white);
-    // Convert C2P to matrix
-    Mat c2pMat = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
-    for (int i = 0; i < c2pList.size(); i++) {
-        auto c2p = c2pList.at(i);
-        c2pMat.at<Vec3b>(c2p.cy, c2p.cx)[0] = ((float)c2p.px / params.width) * 255;
-        c2pMat.at<Vec3b>(c2p.cy, c2p.cx)[1] = ((float)c2p.py / params.height) * 255;
-    }
 
     // Apply mask
     Mat result;
-    c2pMat.copyTo(result, mask);
-    imshow("Masked", result);
-    waitKey(0);
-
-    // Save back into c2p list
-    c2pList.clear();
-    for (int x = 0; x < CAMWIDTH; x++) {
-        for (int y = 0; y < CAMHEIGHT; y++) {
-            int px = result.at<Vec3b>(y,x)[0];
-            int py = result.at<Vec3b>(y,x)[1];
-            px = ((float)px / 255) * params.width;
-            py = ((float)py / 255) * params.height;
-            c2pList.emplace_back(x, y, px, py);
-        }
+    c2pVisualization().copyTo(result, mask);
+    if (preview) {
+        imshow("Masked", result);
+        waitKey(0);
     }
 
+    // Pixels outside the mask are no longer mapped
+    bitwise_and(c2pValid, mask, c2pValid);
+    c2pMap.setTo(Scalar::all(0), c2pValid == 0);
+    invalidateCalibration();
+
     // Save both to disk
-    std::ofstream os("captured" + std::to_string(params.id) + "/c2p.csv");
-    for (C2P elem : c2pList) {
-        os << elem.cx << ", " << elem.cy << ", " << elem.px << ", " << elem.py << std::endl;
-    }
-    os.close();
+    saveC2Plist();
     if (!imwrite("captured" + std::to_string(params.id) + "/result.png", result))
         std::cerr << "Error saving result image!" << std::endl;
 }
 
+bool ProjectorConfig::exportC2Plist() {
+    return C2PFile::exportCSV("captured" + std::to_string(params.id) + "/c2p.csv", c2pMap, c2pValid);
+}
+
 // ------------------------------------------------------------
 // ------------ MEMBER FUNCTIONS (PRIVATE) ---------------------
 // ------------------------------------------------------------
 
-Mat ProjectorConfig::loadC2Plist() {
-    std::ifstream file("captured" + std::to_string(params.id) + "/c2p.csv");
-    std::string line;
+void ProjectorConfig::showPattern(const Mat& image) {
+    if (rig != nullptr)
+        rig->showPattern(params.id, image);
+    else
+        imshow(openPatternWindow(), image);
+}
+
+std::string ProjectorConfig::openPatternWindow() {
+    std::string name = "Pattern " + std::to_string(params.id);
+    if (!patternWindowOpen) {
+        namedWindow(name, WINDOW_NORMAL);
+        resizeWindow(name, params.width, params.height);
+        moveWindow(name, params.posX, params.posY);
+        setWindowProperty(name, WND_PROP_FULLSCREEN, WINDOW_FULLSCREEN);
+        patternWindowOpen = true;
+    }
+    return name;
+}
 
+Mat ProjectorConfig::loadC2Plist() {
+    std::string path = "captured" + std::to_string(params.id);
     Mat viz = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
 
-    if (!file.is_open()) {
-        std::cerr << "Could not open the c2p file!" << std::endl;
-        return viz;
+    // Loads are told apart by whether this process read the file before. That is not a cold page cache: the
+    // operating system may hold the file from an earlier run either way.
+    static std::set<std::string> loadedFiles;
+    bool firstLoad = loadedFiles.insert(path + "/c2p.bin").second;
+
+    auto start = std::chrono::steady_clock::now();
+    C2PFileHeader header;
+    invalidateCalibration();
+    if (!C2PFile::read(path + "/c2p.bin", header, c2pMap, c2pValid)) {
+        // No binary file yet, import the legacy csv once and convert it
+        if (!C2PFile::importCSV(path + "/c2p.csv", CAMWIDTH, CAMHEIGHT, c2pMap, c2pValid)) {
+            std::cerr << "Could not open the c2p file!" << std::endl;
+            return viz;
+        }
+        double csvMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Imported \"" << path << "/c2p.csv\" in " << csvMs << " ms, converting to c2p.bin" << std::endl;
+        header = C2PFileHeader(params.id, CAMWIDTH, CAMHEIGHT, params.width, params.height);
+        C2PFile::write(path + "/c2p.bin", header, c2pMap, c2pValid);
+    } else {
+        double binMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded \"" << path << "/c2p.bin\" in " << binMs << " ms (" << (firstLoad ? "first load in this process" : "repeated load") << ")" << std::endl;
+        if (header.camWidth != CAMWIDTH || header.camHeight != CAMHEIGHT)
+            std::cerr << "C2P file was captured at " << header.camWidth << " x " << header.camHeight
+                      << " but the camera is " << CAMWIDTH << " x " << CAMHEIGHT << "!" << std::endl;
+        if (header.projWidth != params.width || header.projHeight != params.height)
+            std::cerr << "C2P file was calibrated for a " << header.projWidth << " x " << header.projHeight
+                      << " projector but projector " << params.id << " is " << params.width << " x " << params.height << "!" << std::endl;
     }
 
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        int data[4];
-        int index = 0;
+    return c2pVisualization();
+}
 
-        while (std::getline(ss, item, ',')) {
-            data[index++] = std::stoi(item);
+void ProjectorConfig::saveC2Plist() {
+    C2PFileHeader header(params.id, CAMWIDTH, CAMHEIGHT, params.width, params.height);
+    C2PFile::write("captured" + std::to_string(params.id) + "/c2p.bin", header, c2pMap, c2pValid);
+}
+
+void ProjectorConfig::c2pFromVisualization(const Mat& viz) {
+    invalidateCalibration();
+    c2pMap = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_16UC2);
+    c2pValid = Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC1);
+    for (int y = 0; y < CAMHEIGHT; y++) {
+        const Vec3b* vizRow = viz.ptr<Vec3b>(y);
+        Vec2w* mapRow = c2pMap.ptr<Vec2w>(y);
+        uchar* validRow = c2pValid.ptr<uchar>(y);
+        for (int x = 0; x < CAMWIDTH; x++) {
+            int px = ((float)vizRow[x][0] / 255) * params.width;
+            int py = ((float)vizRow[x][1] / 255) * params.height;
+            // Projector pixel (0, 0) is the decoder's "no mapping" value
+            if (px + py == 0) continue;
+            mapRow[x] = Vec2w(px, py);
+            validRow[x] = 255;
         }
+    }
+}
 
-        if (index == 4) {
-            c2pList.emplace_back(data[0], data[1], data[2], data[3]);
-            viz.at<cv::Vec3b>(data[1], data[0])[0] = ((float)data[2] / params.width) * 255;
-            viz.at<cv::Vec3b>(data[1], data[0])[1] = ((float)data[3] / params.height) * 255;
-        } else {
-            std::cerr << "Malformed line in CSV file: " << line << std::endl;
+Mat ProjectorConfig::c2pVisualization() {
+    if (c2pMap.empty()) return Mat::zeros(CAMHEIGHT, CAMWIDTH, CV_8UC3);
+    Mat viz = Mat::zeros(c2pMap.size(), CV_8UC3);
+    for (int y = 0; y < c2pMap.rows; y++) {
+        const Vec2w* mapRow = c2pMap.ptr<Vec2w>(y);
+        const uchar* validRow = c2pValid.ptr<uchar>(y);
+        Vec3b* vizRow = viz.ptr<Vec3b>(y);
+        for (int x = 0; x < c2pMap.cols; x++) {
+            if (!validRow[x]) continue;
+            vizRow[x][0] = ((float)mapRow[x][0] / params.width) * 255;
+            vizRow[x][1] = ((float)mapRow[x][1] / params.height) * 255;
         }
     }
-    file.close();
     return viz;
 }
 
@@ -490,9 +811,75 @@ void ProjectorConfig::loadContribution() {
         std::cerr << "Failed to load contribution matrix for projector" << params.id << "! Check if contribution.png exists." << std::endl;
 
     contributionVisualization.convertTo(contributionMatrix, CV_32FC1, 1.0f/255.0f);
+    computeBlendMap();
+}
+
+void ProjectorConfig::computeBlendMap() {
+    if (contributionMatrix.empty()) return;
+
+    // Same sample positions as the content, which is flipped horizontally before warping, so the contribution is too
+    Size cameraSize = contributionMatrix.size();
+    if (warpMode == WARP_REMAP)
+        computeRemapMaps(cameraSize, blendMapX, blendMapY);
+    else
+        computeHomographyMaps(cameraSize, blendMapX, blendMapY);
+    if (blendMapX.empty()) return;
+
+    Mat flipped, warped;
+    flip(contributionMatrix, flipped, 1);
+    remap(flipped, warped, blendMapX, blendMapY, INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
+    {
+        std::lock_guard<std::mutex> lock(blendMutex);
+        warped.convertTo(blendMap, CV_8UC1, 255.0);
+        blendDirty = true;
+    }
+    requestFrame();
+}
+
+void ProjectorConfig::updateBlendMap(Rect cameraRect) {
+    if (blendMapX.empty() || blendMap.empty()) return;
+
+    // Projector pixels showing the camera rectangle, remap warps also fill holes from further away
+    int minX = INT_MAX, minY = INT_MAX, maxX = -1, maxY = -1;
+    for (int y = cameraRect.y; y < cameraRect.y + cameraRect.height; y++) {
+        const Vec2w* mapRow = c2pMap.ptr<Vec2w>(y);
+        const uchar* validRow = c2pValid.ptr<uchar>(y);
+        for (int x = cameraRect.x; x < cameraRect.x + cameraRect.width; x++) {
+            if (!validRow[x]) continue;
+            minX = std::min(minX, (int)mapRow[x][0]);
+            maxX = std::max(maxX, (int)mapRow[x][0]);
+            minY = std::min(minY, (int)mapRow[x][1]);
+            maxY = std::max(maxY, (int)mapRow[x][1]);
+        }
+    }
+    if (maxX < 0) return;
+    int margin = (warpMode == WARP_REMAP) ? (1 << REMAP_FILL_LEVELS) : BLEND_UPDATE_MARGIN;
+    Rect projectorRect = Rect(Point(minX - margin, minY - margin), Point(maxX + margin + 1, maxY + margin + 1))
+                         & Rect(0, 0, blendMap.cols, blendMap.rows);
+
+    // The maps sample the flipped contribution, mirroring them samples the contribution itself
+    Mat mapX = (float)(contributionMatrix.cols - 1) - blendMapX(projectorRect);
+    Mat warped;
+    remap(contributionMatrix, warped, mapX, blendMapY(projectorRect), INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
+    {
+        std::lock_guard<std::mutex> lock(blendMutex);
+        Mat target = blendMap(projectorRect);
+        warped.convertTo(target, CV_8UC1, 255.0);
+        blendDirty = true;
+    }
+    requestFrame();
+}
+
+void ProjectorConfig::requestFrame() {
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        requestedFrame++;
+    }
+    frameRequested.notify_all();
 }
 
 Mat ProjectorConfig::reduceCalibrationNoise(const Mat& calib) {
+    ScopedTimer timer("denoise", params.id);
     Mat eroded, dilated;
     int morphSize = 1;
     auto kernelSize1 = getStructuringElement(MORPH_RECT, Size(2 * morphSize + 1, 2 * morphSize + 1), Point(morphSize, morphSize));
@@ -507,91 +894,392 @@ Mat ProjectorConfig::reduceCalibrationNoise(const Mat& calib) {
 }
 
 void ProjectorConfig::computeHomography() {
-    if (c2pList.empty()) {
+    if (c2pMap.empty()) {
         std::cerr
                 << "Tried computing homography matrix but C2P points have not been calculated! Try calling decodeGraycode() first!"
                 << std::endl;
         return;
     }
 
+    ScopedTimer timer("fit", params.id);
+    auto start = std::chrono::steady_clock::now();
     std::vector<Point2f> cameraPoints;
     std::vector<Point2f> projectorPoints;
-    for (C2P point : c2pList) {
-        cameraPoints.emplace_back(point.cx, point.cy);
-        projectorPoints.emplace_back(point.px, point.py);
+    sampleCorrespondences(cameraPoints, projectorPoints);
+    if (cameraPoints.size() < 4) {
+        std::cerr << "Projector " << params.id << " has only " << cameraPoints.size()
+                  << " mapped camera pixels, no homography can be fitted!" << std::endl;
+        return;
     }
+
     // Here is where the magic happens
-    homography = findHomography(cameraPoints, projectorPoints, RANSAC);
+    Mat inlierMask;
+    homography = findHomography(cameraPoints, projectorPoints, homographyParams.method,
+                                homographyParams.reprojectionThreshold, inlierMask);
+    double fitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (homography.empty()) {
+        std::cerr << "Fitting the homography of projector " << params.id << " to " << cameraPoints.size()
+                  << " correspondences failed!" << std::endl;
+        return;
+    }
+
+    // Fit quality on the inliers
+    std::vector<Point2f> projected;
+    perspectiveTransform(cameraPoints, projected, homography);
+    uint inlierCount = 0;
+    double squaredErrorSum = 0.0;
+    for (size_t i = 0; i < cameraPoints.size(); i++) {
+        if (!inlierMask.at<uchar>((int)i)) continue;
+        Point2f error = projected[i] - projectorPoints[i];
+        squaredErrorSum += error.dot(error);
+        inlierCount++;
+    }
+    Metrics::count("fitCorrespondences", params.id, (int64_t)cameraPoints.size());
+    Metrics::count("fitInliers", params.id, inlierCount);
+    std::cout << "Homography of projector " << params.id << " fitted to " << cameraPoints.size() << " correspondences in "
+              << fitMs << " ms: " << 100.0 * inlierCount / cameraPoints.size() << " % inliers, reprojection error "
+              << (inlierCount > 0 ? std::sqrt(squaredErrorSum / inlierCount) : 0.0) << " px (RMS)" << std::endl;
     std::cout << "Homography Matrix computed:\n" << homography << std::endl;
     std::cout << "Determinant: " << determinant(homography) << std::endl;
 }
 
-bool ProjectorConfig::initWindow(GLFWwindow* shared) {
-    // Get monitor
-    int count;
-    GLFWmonitor** monitors = glfwGetMonitors(&count);
+bool ProjectorConfig::estimateDrift(const Mat& black, const Mat& lit, Mat& correction) {
+    ScopedTimer timer("drift", params.id);
+    Mat h = getHomography();
+    if (h.empty()) {
+        std::cerr << "Projector " << params.id << " has no calibration to correct!" << std::endl;
+        return false;
+    }
 
-    // Create window
-    window = glfwCreateWindow(params.width, params.height, "Projector", nullptr, shared);
-    if (!window) {
-        std::cerr << "Could not create GLFW window!" << std::endl;
+    // Where the stored calibration expects the marker centers in the camera image
+    std::vector<Point2f> markers = driftMarkerCenters(), expected;
+    perspectiveTransform(markers, expected, h.inv());
+
+    // Marker dots are the blobs that appeared over the black image
+    Mat difference, dots, labels, stats, centroids;
+    GaussianBlur(lit - black, difference, Size(5, 5), 0);
+    threshold(difference, dots, 0, 255, THRESH_BINARY | THRESH_OTSU);
+    int dotCount = connectedComponentsWithStats(dots, labels, stats, centroids, 8, CV_32S);
+
+    // Pair each marker with the closest dot, if the marker is the closest one to that dot as well
+    auto closest = [](const Point2f& point, const std::vector<Point2f>& candidates, double& distance) {
+        int best = -1;
+        distance = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < candidates.size(); i++) {
+            Point2f offset = candidates[i] - point;
+            double d = offset.dot(offset);
+            if (d < distance) { distance = d; best = (int)i; }
+        }
+        distance = std::sqrt(distance);
+        return best;
+    };
+    std::vector<Point2f> found;
+    // Label 0 is the background, specks are noise
+    for (int label = 1; label < dotCount; label++) {
+        if (stats.at<int>(label, CC_STAT_AREA) >= 4)
+            found.emplace_back((float)centroids.at<double>(label, 0), (float)centroids.at<double>(label, 1));
+    }
+    std::vector<Point2f> observedPoints, expectedPoints, markerPoints;
+    for (size_t i = 0; i < expected.size(); i++) {
+        double distance, backDistance;
+        int dot = closest(expected[i], found, distance);
+        if (dot < 0 || distance > DRIFT_MAX_SHIFT || closest(found[dot], expected, backDistance) != (int)i) continue;
+        observedPoints.push_back(found[dot]);
+        expectedPoints.push_back(expected[i]);
+        markerPoints.push_back(markers[i]);
+    }
+    if (observedPoints.size() < DRIFT_MIN_MARKERS) {
+        std::cout << "Projector " << params.id << ": only " << observedPoints.size() << " of " << markers.size()
+                  << " markers found near their calibrated position." << std::endl;
         return false;
     }
-    // Set window position
-    glfwSetWindowPos(window,params.posX, params.posY);
-    // Set event callbacks
-    glfwSetKeyCallback(window, keyCallback);
 
-    glfwMakeContextCurrent(window);
+    // Observed camera pixels are moved to where the calibration knows their projector pixels
+    Mat inlierMask;
+    correction = findHomography(observedPoints, expectedPoints, RANSAC, HOMOGRAPHY_REPROJECTION_THRESHOLD, inlierMask);
+    if (correction.empty()) return false;
+
+    // Residual of the corrected calibration on the markers (projector pixels)
+    std::vector<Point2f> corrected;
+    perspectiveTransform(observedPoints, corrected, h * correction);
+    double squaredErrorSum = 0.0;
+    for (size_t i = 0; i < corrected.size(); i++) {
+        Point2f error = corrected[i] - markerPoints[i];
+        squaredErrorSum += error.dot(error);
+    }
+    double residual = std::sqrt(squaredErrorSum / corrected.size());
+    Metrics::count("driftMarkers", params.id, (int64_t)observedPoints.size());
+    std::cout << "Projector " << params.id << ": " << observedPoints.size() << " markers matched, "
+              << countNonZero(inlierMask) << " inliers, residual " << residual << " px (RMS)" << std::endl;
+    return residual <= DRIFT_MAX_RESIDUAL;
+}
+
+void ProjectorConfig::applyDriftCorrection(const Mat& correction) {
+    // Each camera pixel now sees what the camera pixel correction moves it to saw before
+    Mat h = getHomography() * correction;
+    Size cameraSize(CAMWIDTH, CAMHEIGHT);
+    const int flags = INTER_NEAREST | WARP_INVERSE_MAP;
+    warpPerspective(c2pMap.clone(), c2pMap, correction, cameraSize, flags, BORDER_CONSTANT, Scalar::all(0));
+    warpPerspective(c2pValid.clone(), c2pValid, correction, cameraSize, flags, BORDER_CONSTANT, Scalar(0));
+    if (!white.empty())
+        warpPerspective(white.clone(), white, correction, cameraSize, flags, BORDER_CONSTANT, Scalar(0));
+
+    invalidateCalibration();
+    homography = h / h.at<double>(2, 2);
+    saveC2Plist();
+    // Later launches take the corrected homography instead of refitting it to the corrected C2P map
+    WarpMapFile::writeHomography("captured" + std::to_string(params.id) + "/homography.bin", computeHomographyKey(), homography);
+}
 
-    // For retrieval during static keyCallback function
-    glfwSetWindowUserPointer(window, this);
+std::vector<Point2f> ProjectorConfig::driftMarkerCenters() {
+    std::vector<Point2f> centers;
+    for (int row = 0; row < DRIFT_MARKER_ROWS; row++)
+        for (int col = 0; col < DRIFT_MARKER_COLUMNS; col++)
+            centers.emplace_back((float)(int)((col + 0.5) * params.width / DRIFT_MARKER_COLUMNS),
+                                 (float)(int)((row + 0.5) * params.height / DRIFT_MARKER_ROWS));
+    return centers;
+}
 
-    // Either we have shared state or we need to create it
-    if (shared == nullptr) {
-        std::cout << "No shared OpenGL context, creating..." << std::endl;
-        // glad: load all OpenGL function pointers
-        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-        {
-            std::cerr << "Failed to initialize GLAD" << std::endl;
-            return false;
+void ProjectorConfig::sampleCorrespondences(std::vector<Point2f>& cameraPoints, std::vector<Point2f>& projectorPoints) {
+    cameraPoints.clear();
+    projectorPoints.clear();
+
+    // Unmapped, masked and out of range pixels carry no information about the homography
+    Mat usable = c2pValid.clone();
+    for (int y = 0; y < c2pMap.rows; y++) {
+        const Vec2w* mapRow = c2pMap.ptr<Vec2w>(y);
+        uchar* usableRow = usable.ptr<uchar>(y);
+        for (int x = 0; x < c2pMap.cols; x++) {
+            if (mapRow[x][0] >= params.width || mapRow[x][1] >= params.height || mapRow[x][0] + mapRow[x][1] == 0)
+                usableRow[x] = 0;
         }
+    }
+    int usableCount = countNonZero(usable);
+    if (usableCount == 0) return;
+
+    // Grid cells are sized so that the mapped area holds about sampleBudget of them
+    int budget = (int)std::max(homographyParams.sampleBudget, 4u);
+    int cellSize = std::max(1, (int)std::ceil(std::sqrt((double)usableCount / budget)));
+    cameraPoints.reserve(std::min(usableCount, budget * 2));
+    projectorPoints.reserve(std::min(usableCount, budget * 2));
+    for (int cellY = 0; cellY < usable.rows; cellY += cellSize) {
+        for (int cellX = 0; cellX < usable.cols; cellX += cellSize) {
+            // Take the usable pixel closest to the cell center
+            double centerX = cellX + (cellSize - 1) * 0.5, centerY = cellY + (cellSize - 1) * 0.5;
+            int bestX = -1, bestY = -1;
+            double bestDistance = std::numeric_limits<double>::max();
+            for (int y = cellY; y < std::min(cellY + cellSize, usable.rows); y++) {
+                const uchar* usableRow = usable.ptr<uchar>(y);
+                for (int x = cellX; x < std::min(cellX + cellSize, usable.cols); x++) {
+                    if (!usableRow[x]) continue;
+                    double distance = (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestX = x;
+                        bestY = y;
+                    }
+                }
+            }
+            if (bestX < 0) continue;
+            const Vec2w& projectorPixel = c2pMap.at<Vec2w>(bestY, bestX);
+            cameraPoints.emplace_back(bestX, bestY);
+            projectorPoints.emplace_back(projectorPixel[0], projectorPixel[1]);
+        }
+    }
+}
 
-        // Prepare texture
-        glEnable(GL_TEXTURE_2D);
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+void ProjectorConfig::computeRemapMaps(Size sourceSize, Mat& mapX, Mat& mapY) {
+    mapX.release();
+    mapY.release();
+    if (c2pMap.empty()) {
+        std::cerr << "Tried computing remap lookup table but C2P points have not been calculated! Try calling decodeGraycode() first!"
+                  << std::endl;
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
 
-        // Create buffer objects, array object and linked shader program
-        VBO = createVertexBuffer();
-        EBO = createElementBuffer();
-        shader = createShaderProgram();
+    // Splat every mapped camera pixel (in source image coordinates) onto its projector pixel
+    Size resolution(params.width, params.height);
+    Mat sumX = Mat::zeros(resolution, CV_32F), sumY = Mat::zeros(resolution, CV_32F);
+    Mat hits = Mat::zeros(resolution, CV_32F);
+    float scaleX = (float)sourceSize.width / c2pMap.cols, scaleY = (float)sourceSize.height / c2pMap.rows;
+    for (int y = 0; y < c2pMap.rows; y++) {
+        const Vec2w* mapRow = c2pMap.ptr<Vec2w>(y);
+        const uchar* validRow = c2pValid.ptr<uchar>(y);
+        for (int x = 0; x < c2pMap.cols; x++) {
+            if (!validRow[x] || mapRow[x][0] >= params.width || mapRow[x][1] >= params.height) continue;
+            sumX.at<float>(mapRow[x][1], mapRow[x][0]) += x * scaleX;
+            sumY.at<float>(mapRow[x][1], mapRow[x][0]) += y * scaleY;
+            hits.at<float>(mapRow[x][1], mapRow[x][0]) += 1.0f;
+        }
+    }
+    // Average camera position per projector pixel, premultiplied with a coverage of 1 where anything was hit
+    Mat coverage;
+    threshold(hits, coverage, 0.0, 1.0, THRESH_BINARY);
+    divide(sumX, max(hits, 1.0f), sumX);
+    divide(sumY, max(hits, 1.0f), sumY);
+
+    // Push-pull hole filling: average down a pyramid, then fill each level's holes from the next coarser one
+    std::vector<Mat> levelsX{ sumX }, levelsY{ sumY }, levelsCoverage{ coverage };
+    for (int level = 1; level <= REMAP_FILL_LEVELS && levelsX.back().cols > 1 && levelsX.back().rows > 1; level++) {
+        Size size((levelsX.back().cols + 1) / 2, (levelsX.back().rows + 1) / 2);
+        Mat x, y, c;
+        resize(levelsX.back(), x, size, 0, 0, INTER_AREA);
+        resize(levelsY.back(), y, size, 0, 0, INTER_AREA);
+        resize(levelsCoverage.back(), c, size, 0, 0, INTER_AREA);
+        levelsX.push_back(x);
+        levelsY.push_back(y);
+        levelsCoverage.push_back(c);
+    }
+    for (int level = (int)levelsX.size() - 2; level >= 0; level--) {
+        Size size = levelsX[level].size();
+        Mat x, y, c;
+        resize(levelsX[level + 1], x, size, 0, 0, INTER_LINEAR);
+        resize(levelsY[level + 1], y, size, 0, 0, INTER_LINEAR);
+        resize(levelsCoverage[level + 1], c, size, 0, 0, INTER_LINEAR);
+        Mat missing = 1.0 - levelsCoverage[level];
+        levelsX[level] += x.mul(missing);
+        levelsY[level] += y.mul(missing);
+        levelsCoverage[level] += c.mul(missing);
     }
-    // Buffers objects only need to be created once and are shared, but context state needs to be set for each context
-    VAO = createVertexArray(VBO, EBO);
 
-    return true;
+    // Projector pixels without enough coverage sample outside the source and stay black
+    mapX.create(resolution, CV_32F);
+    mapY.create(resolution, CV_32F);
+    uint mappedCount = 0;
+    for (int y = 0; y < resolution.height; y++) {
+        const float* xRow = levelsX[0].ptr<float>(y);
+        const float* yRow = levelsY[0].ptr<float>(y);
+        const float* coverageRow = levelsCoverage[0].ptr<float>(y);
+        float* mapXRow = mapX.ptr<float>(y);
+        float* mapYRow = mapY.ptr<float>(y);
+        for (int x = 0; x < resolution.width; x++) {
+            if (coverageRow[x] < REMAP_MIN_COVERAGE) {
+                mapXRow[x] = -1.0f;
+                mapYRow[x] = -1.0f;
+                continue;
+            }
+            // Content is flipped horizontally, like warpPerspective() gets it
+            mapXRow[x] = (sourceSize.width - 1) - xRow[x] / coverageRow[x];
+            mapYRow[x] = yRow[x] / coverageRow[x];
+            mappedCount++;
+        }
+    }
+
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Remap lookup table of projector " << params.id << " built in " << buildMs << " ms, "
+              << 100.0 * mappedCount / resolution.area() << " % of projector pixels mapped" << std::endl;
+}
+
+void ProjectorConfig::computeHomographyMaps(Size sourceSize, Mat& mapX, Mat& mapY) {
+    mapX.release();
+    mapY.release();
+    Mat h = getHomography();
+    if (h.empty()) return;
+
+    // warpPerspective() samples the source at the inverse homography
+    Size resolution(params.width, params.height);
+    Matx33d projectorToCamera = Matx33d(h).inv();
+    // The source is stretched over the camera image, like the remap warp does
+    double scaleX = (double)sourceSize.width / CAMWIDTH, scaleY = (double)sourceSize.height / CAMHEIGHT;
+    mapX.create(resolution, CV_32F);
+    mapY.create(resolution, CV_32F);
+    for (int y = 0; y < resolution.height; y++) {
+        float* mapXRow = mapX.ptr<float>(y);
+        float* mapYRow = mapY.ptr<float>(y);
+        for (int x = 0; x < resolution.width; x++) {
+            Vec3d camera = projectorToCamera * Vec3d(x, y, 1.0);
+            double w = (camera[2] != 0.0) ? 1.0 / camera[2] : 0.0;
+            // The homography maps the horizontally flipped image
+            mapXRow[x] = (float)((sourceSize.width - 1) - camera[0] * w * scaleX);
+            mapYRow[x] = (float)(camera[1] * w * scaleY);
+        }
+    }
+}
+
+uint64_t ProjectorConfig::computeWarpMapKey(Size sourceSize) {
+    int settings[6] = { warpMode, sourceSize.width, sourceSize.height, (int)params.width, (int)params.height,
+                        REMAP_FILL_LEVELS };
+    double minCoverage = REMAP_MIN_COVERAGE;
+    uint64_t key = WarpMapFile::hash(settings, sizeof(settings));
+    key = WarpMapFile::hash(&minCoverage, sizeof(minCoverage), key);
+    if (warpMode == WARP_REMAP) {
+        if (c2pHash == 0)
+            c2pHash = WarpMapFile::hash(c2pValid, WarpMapFile::hash(c2pMap));
+        return WarpMapFile::hash(&c2pHash, sizeof(c2pHash), key);
+    }
+    uint64_t homographyKey = computeHomographyKey();
+    return WarpMapFile::hash(&homographyKey, sizeof(homographyKey), key);
 }
 
-void ProjectorConfig::applyContributionMatrix(const Mat& img, Mat& result) {
-    // Split image into color channels
-    std::vector<Mat> channels(3);
-    split(img, channels);
+uint64_t ProjectorConfig::computeHomographyKey() {
+    if (c2pHash == 0)
+        c2pHash = WarpMapFile::hash(c2pValid, WarpMapFile::hash(c2pMap));
+    uint64_t key = WarpMapFile::hash(&c2pHash, sizeof(c2pHash));
+    key = WarpMapFile::hash(&homographyParams.method, sizeof(homographyParams.method), key);
+    key = WarpMapFile::hash(&homographyParams.sampleBudget, sizeof(homographyParams.sampleBudget), key);
+    return WarpMapFile::hash(&homographyParams.reprojectionThreshold, sizeof(homographyParams.reprojectionThreshold), key);
+}
 
-    // Apply contributionMatrix to each channel
-    for (auto& channel : channels) {
-        // Convert to float for multiplication
-        channel.convertTo(channel, CV_32F);
-        multiply(channel, contributionMatrix, channel);
-        // Convert back
-        channel.convertTo(channel, CV_8U);
+bool ProjectorConfig::updateWarpMap(Size sourceSize) {
+    uint64_t key = computeWarpMapKey(sourceSize);
+    if (key == warpMapKey) {
+        warpCacheStats.hits++;
+        return true;
+    }
+    warpCacheStats.misses++;
+    warpMapKey = key;
+
+    // Saved next to the calibration, so the maps survive restarts. Each mode and source size has its own file,
+    // so switching between them does not throw away the other maps.
+    std::string path = "captured" + std::to_string(params.id) + "/warpmap_"
+                       + (warpMode == WARP_REMAP ? "remap_" : "homography_")
+                       + std::to_string(sourceSize.width) + "x" + std::to_string(sourceSize.height) + ".bin";
+    if (WarpMapFile::read(path, key, warpMap1, warpMap2)) {
+        warpCacheStats.diskLoads++;
+        std::cout << "Loaded warp map of projector " << params.id << " from \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    Mat mapX, mapY;
+    if (warpMode == WARP_REMAP)
+        computeRemapMaps(sourceSize, mapX, mapY);
+    else
+        computeHomographyMaps(sourceSize, mapX, mapY);
+    if (mapX.empty()) {
+        warpMap1.release();
+        warpMap2.release();
+        return false;
+    }
+    // Fixed-point maps are considerably faster to remap with
+    convertMaps(mapX, mapY, warpMap1, warpMap2, CV_16SC2);
+    WarpMapFile::write(path, WarpMapFileHeader(key, sourceSize.width, sourceSize.height, params.width, params.height),
+                       warpMap1, warpMap2);
+    return false;
+}
+
+void ProjectorConfig::invalidateCalibration() {
+    homography.release();
+    homographyFailed = false;
+    c2pHash = 0;
+}
+
+void ProjectorConfig::recordWarpTime(bool warm, double warpMs) {
+    Metrics::recordDuration(warm ? "warp" : "warpCold", params.id, warpMs);
+    if (warm) {
+        warpCacheStats.warmMs += warpMs;
+    } else {
+        warpCacheStats.coldMs += warpMs;
+        std::cout << "Projector " << params.id << " cold warp: " << warpMs << " ms" << std::endl;
+    }
+    if (warpCacheStats.hits + warpCacheStats.misses == WARP_REPORT_INTERVAL) {
+        std::cout << "Projector " << params.id << " warp cache: " << warpCacheStats.hits << " hits, "
+                  << warpCacheStats.misses << " misses (" << warpCacheStats.diskLoads << " loaded from disk), "
+                  << (warpCacheStats.hits > 0 ? warpCacheStats.warmMs / warpCacheStats.hits : 0.0) << " ms warm, "
+                  << (warpCacheStats.misses > 0 ? warpCacheStats.coldMs / warpCacheStats.misses : 0.0) << " ms cold per frame"
+                  << std::endl;
+        warpCacheStats = WarpCacheStats();
     }
-    // Merge transformed channels back together
-    merge(channels, result);
 }
 
 Mat ProjectorConfig::computeProjectorAreaMask(const Mat &whiteImg) {
@@ -608,136 +1296,16 @@ Mat ProjectorConfig::computeProjectorAreaMask(const Mat &whiteImg) {
 // ------------------------------------------------------------
 // ------------------------- CONSTRUCTORS ---------------------
 // ------------------------------------------------------------
-ProjectorConfig::ProjectorConfig() : params(ProjectorParams()), window(nullptr), shouldClose(false) {}
-
-ProjectorConfig::ProjectorConfig(ProjectorParams p) : params(p), window(nullptr), shouldClose(false) {}
-
-ProjectorConfig::ProjectorConfig(uint id, const ProjectorConfig* shared) : window(nullptr), shouldClose(false) {
-    int count;
-    auto monitors = glfwGetMonitors(&count);
-    if (id >= count) {
-        std::cerr << "Tried initializing projector with ID " << id << ", but that monitor does not exist!" << std::endl;
-    }
-
-    GLFWmonitor* monitor = monitors[id];
-    const GLFWvidmode* vidMode = glfwGetVideoMode(monitor);
-    int xPos, yPos;
-    glfwGetMonitorPos(monitor, &xPos, &yPos);
-    params = ProjectorParams(id, vidMode->width, vidMode->height, xPos, yPos);
-    std::cout << "Creating full screen window on monitor #" << id << " (" << vidMode->width << " x " << vidMode->height << " px) at "
-              << xPos << "/" << yPos << std::endl;
-
-    initWindow((shared == nullptr) ? nullptr : shared->window);
-}
-
-// ------------------------------------------------------------
-// ------- OPENGL HELPER FUNCTIONS (PRIVATE) ------------------
-// ------------------------------------------------------------
-
-unsigned int ProjectorConfig::createVertexBuffer() {
-    // Vertex data in 3D normalized device coordinates (-1,1)
-    // Everything outside (-1,1) range AFTER vertex shader, will be clipped!
-    float vertices[] = {
-            // positions                      // texture coords
-            1.0f,  1.0f, 0.0f,   1.0f, 1.0f,   // top right
-            1.0f, -1.0f, 0.0f,   1.0f, 0.0f,   // bottom right
-            -1.0f, -1.0f, 0.0f,   0.0f, 0.0f,   // bottom left
-            -1.0f,  1.0f, 0.0f,   0.0f, 1.0f    // top left
-    };
-
-    // Create OpenGL buffer object and save its ID
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    // Bind to target of specific type "GL_ARRAY_BUFFER" for vertex buffer objects
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // Because of binding calls to "GL_ARRAY_BUFFER" will now redirect to our bound "VBO" buffer, where we place the data
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
-                 GL_STATIC_DRAW); // STATIC_DRAW = data set once, used often
-    // Unbind buffer
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    return VBO;
-}
-
-unsigned int ProjectorConfig::createElementBuffer() {
-    // Index data pointing to the vertices in VBO
-    unsigned int indices[] = {
-            0, 1, 3, // first triangle
-            1, 2, 3  // second triangle
-    };
-
-    // Create OpenGL Element Buffer object and save its ID
-    unsigned int EBO;
-    glGenBuffers(1, &EBO);
-    // Bind and set the buffer data to the indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    // Unbind
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    return EBO;
-}
-
-unsigned int ProjectorConfig::createVertexArray(unsigned int vertexBuffer, unsigned int elementBuffer) {
-    // Create OpenGL vertex array object and save its ID
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-    // Bind the vertex array
-    glBindVertexArray(VAO); {
-        // Bind the buffers belonging to this vertex array
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);            // Contains the vertex data
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);   // Contains the order in which to visit vertices
-        // Set Vertex Attribute Pointers (tells the VAO how to use currently bound VBO data)
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);// Set Vertex Attribute Pointers (tells the VAO how to use currently bound VBO data)
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        // Unbind the VBO
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-    // Unbind the VAO
-    glBindVertexArray(0);
-    // Unbind the EBO after(!) the VAO so the binding is saved
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-    return VAO;
-}
-
-unsigned int ProjectorConfig::compileShader(const char* shaderSource, int shaderType) {
-    unsigned int shader;
-    shader = glCreateShader(shaderType);
-    // Attach shader source code and compile
-    glShaderSource(shader, 1, &shaderSource, nullptr);
-    glCompileShader(shader);
-    // Check if compilation was successful
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "ERROR! Shader compilation failed. Log:\n" << infoLog << std::endl;
-    }
-    return shader;
-}
-
-unsigned int ProjectorConfig::createShaderProgram() {
-    unsigned int vertexShader = compileShader(VERTEXSHADERSOURCE, GL_VERTEX_SHADER);
-    unsigned int fragmentShader = compileShader(FRAGMENTSHADERSOURCE, GL_FRAGMENT_SHADER);
-
-    // Create an OpenGL shader program object and save its ID
-    unsigned int shaderProgram;
-    shaderProgram = glCreateProgram();
-    // Attach shaders and link
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    // Check for link errors
-    int success;
-    char infoLog[512];
-    glGetProgramiv(shaderProgram, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR! Shader program compilation failed. Log:\n" << infoLog << std::endl;
-    }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    return shaderProgram;
-}
\ No newline at end of file
+ProjectorConfig::ProjectorConfig() : params(ProjectorParams()), window(nullptr), shouldClose(false), patternWindowOpen(false),
+    streamTexture(0), uploadBuffers{}, uploadIndex(0), contentDirty(false), warpBufferIndex(0), redrawNeeded(false),
+    vertexArray(0), shader(0), warpEnabledLocation(-1), fragToTextureLocation(-1), blendEnabledLocation(-1),
+    framebufferWidth(0), framebufferHeight(0),
+    warpMode(WARP_HOMOGRAPHY), warpMapKey(0), c2pHash(0), homographyFailed(false),
+    blendTexture(0), blendDirty(false) {}
+
+ProjectorConfig::ProjectorConfig(ProjectorParams p) : params(p), window(nullptr), shouldClose(false), patternWindowOpen(false),
+    streamTexture(0), uploadBuffers{}, uploadIndex(0), contentDirty(false), warpBufferIndex(0), redrawNeeded(false),
+    vertexArray(0), shader(0), warpEnabledLocation(-1), fragToTextureLocation(-1), blendEnabledLocation(-1),
+    framebufferWidth(0), framebufferHeight(0),
+    warpMode(WARP_HOMOGRAPHY), warpMapKey(0), c2pHash(0), homographyFailed(false),
+    blendTexture(0), blendDirty(false) {}
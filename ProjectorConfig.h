@@ -6,12 +6,28 @@
 #define CLIMBPM_PROJECTORCONFIG_H
 
 #include <vector>
+#include <cstring>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include <opencv2/structured_light.hpp>
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
 #include <fstream>
+#include <chrono>
+#include <set>
 #include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "C2PFile.h"
+#include "GraycodeDecoder.h"
+#include "AsyncImageWriter.h"
+#include "WarpMapFile.h"
+#include "AllocationCounter.h"
+#include "Metrics.h"
+#include "Rig.h"
+#include "CameraGrabber.h"
+#include "FrameBarrier.h"
 #ifdef __APPLE__
 namespace fs = std::__fs::filesystem;
 #else
@@ -20,29 +36,69 @@ namespace fs = std::filesystem;
 
 #define WHITETHRESHOLD 80
 #define BLACKTHRESHOLD 20
+// Upper limit for waiting until a projected pattern has settled in the camera image (ms)
 #define PATTERN_DELAY 5000
+// Settle detection: number of consecutive frames that have to stay below the noise floor
+#define SETTLE_STABLE_FRAMES 3
+// Settle detection: mean absolute gray value difference between two frames that is still considered camera noise
+#define SETTLE_NOISE_FLOOR 1.5
+// Settle detection: mean absolute gray value difference to the previous pattern's frame that counts as a change
+#define SETTLE_CHANGE_THRESHOLD 4.0
+// Settle detection: gray value difference to the previous pattern's frame at which a (downscaled) pixel changed for sure
+#define SETTLE_AREA_THRESHOLD 40.0
+// Settle detection: share of pixels changed for sure that counts as a change, even if the mean barely moves
+// (e.g. when a projector that covers a small part of the camera image lights up)
+#define SETTLE_AREA_MIN_SHARE 0.001
+// Graycode capture: images queued per writer thread, capturing waits for the disk beyond that (bounds the memory held)
+#define CAPTURE_WRITE_QUEUE_PER_THREAD 2
+// Number of pixel unpack buffers each projector cycles through when uploading frames
+#define UPLOAD_BUFFER_COUNT 2
+// Number of frames after which the average upload time is printed
+#define UPLOAD_REPORT_INTERVAL 600
+// Number of buffers each projector warps frames into before handing them to its render thread
+// (frames queued by a VideoPlayer, pending and being uploaded)
+#define WARP_BUFFER_COUNT 6
+// Number of frames after which the average swap and frame barrier times are printed
+#define SWAP_REPORT_INTERVAL 600
+// Footprint probe: brightness increase over the all-black image that counts as lit by the probed projector
+#define FOOTPRINT_THRESHOLD 40
+// Footprint probe: safety margin around each projector's footprint (camera pixels)
+#define FOOTPRINT_MARGIN 15
+// Remap warp: number of coarser levels holes in the inverted C2P map are filled from (fills holes up to ~2^levels px)
+#define REMAP_FILL_LEVELS 5
+// Remap warp: minimum coverage after hole filling for a projector pixel to be mapped at all
+#define REMAP_MIN_COVERAGE 0.5
+// Number of warped frames after which the warp cache statistics are printed
+#define WARP_REPORT_INTERVAL 600
+// Homography fit: maximum number of correspondences, sampled evenly over the mapped camera area
+#define HOMOGRAPHY_SAMPLE_BUDGET 20000
+// Homography fit: maximum reprojection error of inliers (projector pixels)
+#define HOMOGRAPHY_REPROJECTION_THRESHOLD 3.0
+// Pyramid decode: size of the tiles interpolated from their corners (camera pixels)
+#define PYRAMID_TILE_SIZE 8
+// Pyramid decode: largest deviation of a tile's samples from the interpolation that is accepted (projector pixels)
+#define PYRAMID_TOLERANCE 1.0f
+// Partial blend map updates extend this far beyond the projector pixels of the changed camera area (projector pixels)
+#define BLEND_UPDATE_MARGIN 4
+// Drift correction: grid of marker dots projected instead of the graycodes
+#define DRIFT_MARKER_COLUMNS 16
+#define DRIFT_MARKER_ROWS 9
+#define DRIFT_MARKER_RADIUS 8
+// Drift correction: markers found further from where the stored calibration expects them are not matched (camera pixels)
+#define DRIFT_MAX_SHIFT 40.0
+// Drift correction: with fewer matched markers or a larger RMS residual (projector pixels) the projector is fully recalibrated
+#define DRIFT_MIN_MARKERS 12
+#define DRIFT_MAX_RESIDUAL 2.0
 
 // Shader code (nothing fancy, basic texturing)
 #define VERTEXSHADERSOURCE "#version 330 core\nlayout (location = 0) in vec3 aPos;\nlayout (location = 1) in vec2 aTexCoord;\nout vec2 texCoord;\nvoid main()\n{\ngl_Position = vec4(aPos, 1.0);\ntexCoord = aTexCoord;\n}\0"
-#define FRAGMENTSHADERSOURCE "#version 330 core\nout vec4 FragColor;\nin vec2 texCoord;\nuniform sampler2D ourTexture;\nvoid main()\n{\nFragColor = texture(ourTexture, texCoord);\n}\n"
+// With warpEnabled, the texture holds the unwarped camera space image and fragToTexture maps window coordinates
+// to its texture coordinates (homography and flips folded in), so the warp happens while sampling.
+// With blendEnabled, the color is weighted with the projector's contribution (projector space, like texCoord).
+#define FRAGMENTSHADERSOURCE "#version 330 core\nout vec4 FragColor;\nin vec2 texCoord;\nuniform sampler2D ourTexture;\nuniform sampler2D blendTexture;\nuniform bool warpEnabled;\nuniform bool blendEnabled;\nuniform mat3 fragToTexture;\nvoid main()\n{\nvec2 uv = texCoord;\nif (warpEnabled) {\nvec3 p = fragToTexture * vec3(gl_FragCoord.xy, 1.0);\nif (p.z <= 0.0) { FragColor = vec4(0.0, 0.0, 0.0, 1.0); return; }\nuv = p.xy / p.z;\n}\nFragColor = texture(ourTexture, uv);\nif (blendEnabled) FragColor.rgb *= texture(blendTexture, texCoord).r;\n}\n"
 
 using namespace cv;
 
-// Camera to Projector
-struct C2P {
-    int cx;
-    int cy;
-    int px;
-    int py;
-    C2P(int camera_x, int camera_y, int proj_x, int proj_y)
-    {
-        cx = camera_x;
-        cy = camera_y;
-        px = proj_x;
-        py = proj_y;
-    }
-};
-
 struct ProjectorParams {
     ushort id;
     uint width;
@@ -54,17 +110,157 @@ struct ProjectorParams {
     ProjectorParams() : id(0), width(0), height(0), posX(0), posY(0) {}
 };
 
+// How warpImage() transforms camera space images into projector space. In every mode (and in the GPU warp), source
+// images of any size are stretched over the whole camera image, so all projectors place content alike.
+enum WarpMode {
+    // warpPerspective() with the homography fitted to the C2P map
+    WARP_HOMOGRAPHY,
+    // remap() with a per-pixel lookup table inverted from the C2P map, also works where no homography fits
+    WARP_REMAP
+};
+
+// Parameters of the settle detection used while capturing graycodes
+struct SettleParams {
+    uint stableFrames;
+    double noiseFloor;
+    double changeThreshold;
+    double areaThreshold;
+    double areaMinShare;
+    uint timeoutMs;
+    SettleParams() : stableFrames(SETTLE_STABLE_FRAMES), noiseFloor(SETTLE_NOISE_FLOOR),
+    changeThreshold(SETTLE_CHANGE_THRESHOLD), areaThreshold(SETTLE_AREA_THRESHOLD), areaMinShare(SETTLE_AREA_MIN_SHARE),
+    timeoutMs(PATTERN_DELAY) {}
+};
+
+// Parameters of the homography fit to the C2P map
+struct HomographyParams {
+    // Robust estimator passed to findHomography(), USAC_MAGSAC where available
+    int method;
+    uint sampleBudget;
+    double reprojectionThreshold;
+    HomographyParams() :
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 5)
+    method(USAC_MAGSAC),
+#else
+    method(RANSAC),
+#endif
+    sampleBudget(HOMOGRAPHY_SAMPLE_BUDGET), reprojectionThreshold(HOMOGRAPHY_REPROJECTION_THRESHOLD) {}
+};
+
+// Timing of a projector's texture uploads
+struct UploadStats {
+    uint frames;
+    double totalMs;
+    double maxMs;
+    UploadStats() : frames(0), totalMs(0.0), maxMs(0.0) {}
+};
+
+// Timing of a projector's buffer swaps and of the wait for the other projectors before them
+struct SwapStats {
+    uint frames;
+    double totalMs;
+    double maxMs;
+    double barrierMs;
+    SwapStats() : frames(0), totalMs(0.0), maxMs(0.0), barrierMs(0.0) {}
+};
+
+// Shared by the render threads of presentContent(), guarded by ProjectorConfig::frameMutex
+struct FrameSchedule {
+    // Keeps the render threads in lockstep, its completions update the frames below
+    FrameBarrier barrier;
+    // Frame all projectors presented last and the one they are drawing
+    uint64_t presentedFrame;
+    uint64_t targetFrame;
+    bool stopping;
+    FrameSchedule(uint count, uint64_t frame) : barrier(count), presentedFrame(frame), targetFrame(frame), stopping(false) {}
+};
+
+// Per-frame state of a projector, allocated once and reused so that steady state frames do not allocate
+struct FrameContext {
+    // Size and type of the stream texture's storage
+    Size streamSize;
+    int streamType;
+    // Warp maps with reversed rows, so warping writes the bottom row first as OpenGL expects
+    Mat uploadMap1, uploadMap2;
+    uint64_t uploadMapKey;
+    // When the window's buffers were last swapped, for the frame interval histogram
+    std::chrono::steady_clock::time_point lastSwap;
+    // Frames projected and frames that allocated heap memory (counted in debug builds) since the last report
+    uint frames;
+    uint allocatingFrames;
+    FrameContext() : streamType(-1), uploadMapKey(0), frames(0), allocatingFrames(0) {}
+};
+
+// Use of a projector's warp maps: hits reuse the maps in memory, misses load them from disk or compute them
+struct WarpCacheStats {
+    uint hits;
+    uint misses;
+    uint diskLoads;
+    double warmMs;
+    double coldMs;
+    WarpCacheStats() : hits(0), misses(0), diskLoads(0), warmMs(0.0), coldMs(0.0) {}
+};
+
+// Per-pixel statistics of a graycode decoding pass
+struct DecodeStats {
+    uint pxlCount;
+    // Pixels inside the row spans of the projector's footprint, the only ones that are decoded
+    uint decodedPxlCount;
+    // Footprint pixels the pyramid decode did not interpolate but decoded at full resolution
+    uint refinedPxlCount;
+    uint thresholdFailCount;
+    uint projPxlCount;
+    uint mappedPxlCount;
+    uint ambientCount;
+    DecodeStats() : pxlCount(0), decodedPxlCount(0), refinedPxlCount(0), thresholdFailCount(0), projPxlCount(0), mappedPxlCount(0), ambientCount(0) {}
+    DecodeStats& operator+=(const DecodeStats& other) {
+        pxlCount += other.pxlCount;
+        decodedPxlCount += other.decodedPxlCount;
+        refinedPxlCount += other.refinedPxlCount;
+        thresholdFailCount += other.thresholdFailCount;
+        projPxlCount += other.projPxlCount;
+        mappedPxlCount += other.mappedPxlCount;
+        ambientCount += other.ambientCount;
+        return *this;
+    }
+};
+
 class ProjectorConfig {
+    // The benchmark times private calibration stages, the simulation compares them against ground truth
+    friend class Benchmark;
+    friend class Simulation;
+    // Reads the camera and rewrites contributions while the projectors are running
+    friend class ShadowCompensator;
+    // Hands its frames to the render threads of presentContent()
+    friend class VideoPlayer;
 public:
     // -------- STATIC VARIABLES ---------
     static uint CAMHEIGHT, CAMWIDTH;
+    static SettleParams settleParams;
+    static HomographyParams homographyParams;
 
     // -------- STATIC FUNCTIONS ---------
     static bool initGLFW();
-    static void initCamera();
+    // Calibrates with rig instead of the pattern windows and the camera (nullptr switches back)
+    static void setRig(Rig* virtualRig);
+    // Starts grabbing camera frames in the background, grayscale skips the color conversion (calibration only needs gray)
+    static void initCamera(bool grayscale = true);
+    // Computes each projector's share of the brightness of every camera pixel and warps it into a blend map,
+    // which is applied when drawing from then on
     static void computeContributions(ProjectorConfig* projectors, int count);
-    static void projectImage(ProjectorConfig* projectors, uint count, const Mat& img);
+    // Projects img (camera space) on all projectors until one window is closed.
+    // With gpuWarp, img is uploaded once and each projector warps it in the fragment shader instead of on the CPU.
+    // The shader always warps with the homography, so projectors set to WARP_REMAP are drawn with it anyway, and
+    // projectors without a homography stay black.
+    // Windows are only redrawn when their content changes (see updateContent()) or they are exposed/resized,
+    // otherwise the calling thread sleeps in glfwWaitEvents().
+    static void projectImage(ProjectorConfig* projectors, uint count, const Mat& img, bool gpuWarp = false);
     static void computeBrightnessMap(ProjectorConfig* projectors, int count);
+    // Calibrates all projectors, capturing projectors with non-overlapping footprints in the same graycode sequence
+    static void calibrateMultiplexed(ProjectorConfig* projectors, int count);
+    // Corrects the existing calibrations after the camera or projectors were bumped, using one marker image per
+    // projector. Projectors whose drift is no small homography in camera space are calibrated from scratch.
+    static void correctDrift(ProjectorConfig* projectors, int count);
 
     // -------- MEMBER FUNCTIONS ------
     bool wantsToClose() { return shouldClose; }
@@ -74,15 +270,35 @@ public:
     void captureGraycodes();
     // Loads previously captured graycode projection images from files
     void loadGraycodes();
-    // Decodes the captured images and generates c2pList, returns visualization
-    Mat decodeGraycode();
+    // Decodes the captured images and generates the c2p map, returns visualization
+    Mat decodeGraycode(DecodeBackend backend = DECODE_BITPLANE);
     Mat getHomography();
-    Mat warpImage(Mat img, bool save = false);
-    void projectImage(Mat img, bool warp);
+    Mat warpImage(const Mat& img, bool save = false);
+    // Warps into warped, which is only (re)allocated if its size or type does not match
+    void warpImage(const Mat& img, Mat& warped);
+    // The GPU warp always uses the homography
+    void setWarpMode(WarpMode mode) { warpMode = mode; computeBlendMap(); }
+    WarpMode getWarpMode() { return warpMode; }
+    // Shows img on this projector, warping writes straight into the upload buffer
+    void projectImage(const Mat& img, bool warp);
+    // Replaces what this projector shows while the static projectImage() is running, can be called from any thread
+    // (with warp, only one thread at a time per projector, which warps into the projector's reused buffers).
+    // While the shared texture is drawn warped (gpuWarp), img replaces the source image of all projectors and has
+    // to match its size; the GPU warps it whatever warp says.
+    void updateContent(const Mat& img, bool warp);
+    // Renders img through the shader warp and reads the result back (projector resolution, BGR)
+    Mat renderWarpedGPU(const Mat& img);
+    // Compares the shader warp against warpImage() and returns the fraction of pixels differing by more than tolerance
+    double verifyGPUWarp(const Mat& img, int tolerance = 2);
+    // Opens the projector window for a configuration created from ProjectorParams, e.g. hidden for offscreen rendering
+    bool openWindow(const ProjectorConfig* shared = nullptr, bool visible = true);
     void visualizeContribution();
     // Initializes the configuration from existing files
     void loadConfiguration();
-    void applyAreaMask();
+    // Masks the C2P map with the projector area, preview shows the result and waits for a key
+    void applyAreaMask(bool preview = true);
+    // Exports the C2P map as legacy c2p.csv file
+    bool exportC2Plist();
 
     // ----- CONSTRUCTORS ----------
     ProjectorConfig();
@@ -91,24 +307,84 @@ public:
 
 private:
     // ----- STATIC VARIABLES ------
-    static VideoCapture camera;
+    static CameraGrabber camera;
+    static Rig* rig;
     static Mat brightnessMap; // unused
     // Shared OpenGL resources
-    static unsigned int EBO, VBO, VAO;
-    static unsigned int shader;
+    static unsigned int EBO, VBO;
     static GLuint texture;
+    // Signaled once the last uploadSourceImage() is complete, the other contexts wait for it before sampling texture
+    static GLsync textureUploaded;
+    // Guards pendingContent and contentDirty of all projectors, sharedSourceSize and pendingSource
+    static std::mutex contentMutex;
+    // Size of the source image while presentContent() draws the shared texture warped, empty otherwise
+    static Size sharedSourceSize;
+    // Image handed over by updateContent() while the shared texture is drawn, uploaded once for all projectors
+    static Mat pendingSource;
+    // Guards blendMap and blendDirty of all projectors, which are updated while drawing
+    static std::mutex blendMutex;
+    // Frames requested from the render threads of presentContent(), which draw until they presented the latest
+    static std::mutex frameMutex;
+    static std::condition_variable frameRequested;
+    static uint64_t requestedFrame;
 
     // ------ STATIC FUNCTIONS ---------------------------
     static void getProjectionBoundaries(int count, int& minX, int& minY, int& maxX, int& maxY); // unused
     static void keyCallback(GLFWwindow* window, int key, int scandone, int action, int mods);
+    static void refreshCallback(GLFWwindow* window);
+    static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
     static void errorCallback(int error, const char* description);
+    // First camera frame taken after the call (gray or BGR, see initCamera()), shared with the grabber's ring
     static Mat getCameraImage();
+    // Same with the time the frame was grabbed, returns false if there is none
+    static bool getCameraFrame(CameraFrame& frame);
+    // Reads camera frames until the image differs from previous and then stays stable, returns false on timeout
+    static bool captureSettledFrame(const Mat& previous, double maxChangeMs, Mat& settled, double& changeMs, double& settleMs);
+    // Projects and captures the graycodes of all projectors in group at once, masking each capture with the
+    // projector's footprint (if given)
+    static void captureGraycodes(const std::vector<ProjectorConfig*>& group, const std::vector<Mat>& footprints);
+    // Lights up one projector after another and returns the camera area lit by each one
+    static std::vector<Mat> probeFootprints(ProjectorConfig* projectors, int count);
+    // Redraws projectors whose content changed or whose window needs it until one window is closed.
+    // With a non-empty warpSourceSize, the shared texture is drawn warped instead of each projector's own.
+    // Also returns once finished (if given) returns true, checked whenever window events wake up the main thread.
+    static void presentContent(ProjectorConfig* projectors, uint count, Size warpSourceSize = Size(),
+                               const std::function<bool()>& finished = nullptr);
+    // Draws and swaps one projector on its own thread, in lockstep with the others through the barrier
+    static void renderProjector(ProjectorConfig& projector, FrameSchedule& schedule, Size warpSourceSize);
+    // Makes the render threads of presentContent() draw a new frame, can be called from any thread
+    static void requestFrame();
 
     // ----- MEMBER VARIABLES -------
     // Whether our window wants to be close
     bool shouldClose;
     // GLFW Window
     GLFWwindow* window;
+    // Whether the OpenCV window for graycode patterns was opened
+    bool patternWindowOpen;
+    // Texture the frames of this projector are streamed into and the pixel unpack buffers used for that
+    GLuint streamTexture;
+    GLuint uploadBuffers[UPLOAD_BUFFER_COUNT];
+    int uploadIndex;
+    FrameContext frameContext;
+    UploadStats uploadStats;
+    // Image handed over by updateContent(), uploaded by the presenting thread
+    Mat pendingContent;
+    bool contentDirty;
+    // Frames warped for the render thread, reused once nothing else holds them (see warpToBuffer())
+    Mat warpBuffers[WARP_BUFFER_COUNT];
+    uint warpBufferIndex;
+    // Window was exposed or resized and has to be drawn again (main thread only)
+    bool redrawNeeded;
+    // Vertex array of this window's context (vertex arrays are not shared between contexts)
+    GLuint vertexArray;
+    // Shader program of this window: uniforms belong to the program, which would be shared by all contexts,
+    // so render threads setting them at the same time would draw with each other's homography
+    unsigned int shader;
+    GLint warpEnabledLocation, fragToTextureLocation, blendEnabledLocation;
+    // Size of the window's framebuffer, kept by the main thread for the render threads (guarded by contentMutex)
+    int framebufferWidth, framebufferHeight;
+    SwapStats swapStats;
     // Parameters of this projector
     ProjectorParams params;
     Ptr<structured_light::GrayCodePattern> pattern;
@@ -117,23 +393,101 @@ private:
     // Captured images of projecting the graycodes from this projector
     std::vector<Mat> captured;
     Mat white;
-    // The camera-to-projector config of this projector
-    std::vector<C2P> c2pList;
-    // Homography matrix computed from c2p list
+    // The camera-to-projector config of this projector, indexed by camera pixel:
+    // projector coordinates (CV_16UC2) and whether the camera pixel is mapped at all (CV_8UC1, 0 or 255)
+    Mat c2pMap;
+    Mat c2pValid;
+    // Homography matrix computed from c2p map
     Mat homography;
+    WarpMode warpMode;
+    // Fixed-point projector-to-source sample positions used by warpImage() for either warp mode,
+    // cached in memory and in one file per warp mode and source size under a key hashed from everything they depend on
+    Mat warpMap1, warpMap2;
+    uint64_t warpMapKey;
+    WarpCacheStats warpCacheStats;
+    // Hash of the C2P map, 0 until computed
+    uint64_t c2pHash;
+    // getHomography() could not fit one to the current C2P map, so it does not try again every frame
+    bool homographyFailed;
     // Matrix containing the shared contribution to each pixel in camera space
-    Mat contributionMatrix; // unused
+    Mat contributionMatrix;
+    // Contribution in projector space (CV_8UC1, 255 = full brightness), multiplied in the shader
+    Mat blendMap;
+    GLuint blendTexture;
+    // blendMap changed since it was uploaded
+    bool blendDirty;
+    // Camera space sample positions blendMap was warped with (flipped like the content), for partial updates
+    Mat blendMapX, blendMapY;
 
     // ------------ MEMBER FUNCTIONS -----------------------
-    void applyContributionMatrix(const Mat& img, Mat& result); // unused
+    // Warps contributionMatrix into blendMap with the geometry of the current warp mode
+    void computeBlendMap();
+    // Warps the part of contributionMatrix inside cameraRect into blendMap again
+    void updateBlendMap(Rect cameraRect);
     Mat reduceCalibrationNoise(const Mat& calib);
     void computeHomography();
+    // Fits the camera space homography that moves the markers seen in lit (minus black) back to where the stored
+    // calibration expects them, returns false if too few markers match or the residual is too large
+    bool estimateDrift(const Mat& black, const Mat& lit, Mat& correction);
+    // Moves the C2P map, white image and homography by the drift correction and saves the C2P map
+    void applyDriftCorrection(const Mat& correction);
+    // Projector pixels the drift markers are centered on (whole pixels, so they are drawn exactly there)
+    std::vector<Point2f> driftMarkerCenters();
+    // Collects mapped camera pixels and their projector pixels, at most one per grid cell so that the
+    // whole mapped area is covered with about homographyParams.sampleBudget correspondences
+    void sampleCorrespondences(std::vector<Point2f>& cameraPoints, std::vector<Point2f>& projectorPoints);
+    // Inverts the C2P map into the remap warp's lookup table for images of sourceSize (horizontal flip included)
+    void computeRemapMaps(Size sourceSize, Mat& mapX, Mat& mapY);
+    // Sample positions of warpPerspective() with the homography for images of sourceSize (horizontal flip included)
+    void computeHomographyMaps(Size sourceSize, Mat& mapX, Mat& mapY);
+    // Identifies the homography by what it is fitted from (C2P map and homographyParams), without fitting it
+    uint64_t computeHomographyKey();
+    uint64_t computeWarpMapKey(Size sourceSize);
+    // Makes the warp maps match the current calibration and sourceSize, returns false on a cache miss
+    bool updateWarpMap(Size sourceSize);
+    // Drops everything derived from the C2P map after it changed
+    void invalidateCalibration();
     Mat computeProjectorAreaMask(const Mat& whiteImg);
-    // Loads the C2P list from .csv file
+    // Loads the C2P map from c2p.bin (imports c2p.csv if no binary file exists yet)
     Mat loadC2Plist();
+    // Saves the C2P map as c2p.bin
+    void saveC2Plist();
+    // Converts a (denoised) visualization back into the C2P map
+    void c2pFromVisualization(const Mat& viz);
+    // Visualizes the C2P map as normalized projector coordinates in the blue and green channel
+    Mat c2pVisualization();
     // Loads contribution matrix from file
     void loadContribution();
+    // Shows a calibration image on this projector's pattern window (or the rig's projector)
+    void showPattern(const Mat& image);
+    // Opens the full screen OpenCV window graycodes are shown in (if not open yet) and returns its name
+    std::string openPatternWindow();
     bool initWindow(GLFWwindow* shared = nullptr);
+    // Streams a frame (8 bit gray, BGR or BGRA) into this projector's texture through the pixel unpack buffer ring.
+    // With warp, the frame is warped, flipped vertically and written into the buffer in a single remap().
+    void uploadFrame(const Mat& frame, bool warp = false);
+    // Warps into one of warpBuffers that no frame in flight holds and returns it (a new image if all are held).
+    // Must only be called from one thread at a time per projector.
+    Mat warpToBuffer(const Mat& img);
+    // Counts the frame as allocating if the allocation count changed since allocationsBefore and reports
+    void recordFrameAllocations(uint64_t allocationsBefore);
+    // Updates frameContext's upload maps for frames of sourceSize, returns false on a warp cache miss
+    bool prepareUploadMaps(Size sourceSize);
+    // Adds a frame's warp time to the warp cache statistics and reports them
+    void recordWarpTime(bool warm, double warpMs);
+    // Draws this projector's texture and swaps buffers (unless the caller swaps)
+    void drawStream(bool swap = true);
+    // Uploads a camera space image into the shared texture, unflipped
+    static void uploadSourceImage(const Mat& img);
+    // Draws the shared texture warped with the homography and swaps buffers (unless the caller swaps),
+    // sourceSize is the size of the uploaded image
+    void drawWarped(Size sourceSize, bool swap = true);
+    // Swaps the window's buffers, timing the swap and the interval since the previous one
+    void swapBuffers();
+    // Binds the blend texture to texture unit 1 (uploading it if needed) and enables blending in the shader
+    void bindBlendTexture(bool enabled);
+    // Window-to-texture coordinate transform used by the shader warp
+    Matx33d computeFragToTexture(Size sourceSize, int framebufferWidth, int framebufferHeight);
 
     // ------- OPENGL HELPER FUNCTIONS ----------
     unsigned int createVertexBuffer();
@@ -0,0 +1,757 @@
+//
+// OpenGL side of ProjectorConfig: windows, texture uploads and drawing.
+// Kept apart so that ProjectorConfig.cpp (calibration and warping) builds without OpenGL/GLFW.
+//
+
+#include "ProjectorConfig.h"
+
+// --------- STATIC MEMBERS ---------------
+unsigned int ProjectorConfig::EBO;
+unsigned int ProjectorConfig::VBO;
+GLuint ProjectorConfig::texture;
+GLsync ProjectorConfig::textureUploaded = nullptr;
+std::mutex ProjectorConfig::contentMutex;
+Size ProjectorConfig::sharedSourceSize;
+Mat ProjectorConfig::pendingSource;
+
+// ------------------------------------------------------------
+// ------------ STATIC FUNCTIONS (PUBLIC) ---------------------
+// ------------------------------------------------------------
+
+bool ProjectorConfig::initGLFW() {
+    glfwSetErrorCallback(errorCallback);
+    if (!glfwInit())
+        return false;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For macOS compatibility
+
+    return true;
+}
+
+void ProjectorConfig::projectImage(ProjectorConfig* projectors, uint count, const Mat& img, bool gpuWarp) {
+    if (gpuWarp) {
+        // The shared texture is uploaded once, every projector samples it through its own homography
+        glfwMakeContextCurrent(projectors[0].window);
+        uploadSourceImage(img);
+        presentContent(projectors, count, img.size());
+        return;
+    }
+
+    // The static way, warp images for each projector beforehand
+    for (int i = 0; i < count; i++) {
+        projectors[i].updateContent(projectors[i].warpImage(img, true), false);
+    }
+    presentContent(projectors, count);
+}
+
+void ProjectorConfig::computeBrightnessMap(ProjectorConfig *projectors, int count) {
+    // Capture image with white from all projectors
+    cv::Mat whiteImg = cv::Mat(CAMHEIGHT, CAMWIDTH, CV_8UC3, cv::Scalar(255, 255, 255));
+    for (int i = 0; i < count; i++) {
+        projectors[i].projectImage(whiteImg, false);
+    }
+    waitKey(5000);
+    // Frames are taken after the call, so none is stale
+    auto whiteCaptured = getCameraImage();
+    imshow("White Maximum All Projectors", whiteCaptured);
+    waitKey(0);
+    Mat grayScale;
+    if (whiteCaptured.channels() == 1)
+        grayScale = whiteCaptured;
+    else
+        cvtColor(whiteCaptured, grayScale, COLOR_BGR2GRAY);
+    imwrite("BrightnessMap/grayscale.png", grayScale);
+    // Apply low-pass filter to get the map above specified brightness
+    const uint MIN_BRIGHTNESS = 150;
+    Mat filtered;
+    threshold(grayScale, filtered, MIN_BRIGHTNESS, 255, THRESH_TOZERO);
+    imwrite("BrightnessMap/filtered.png", filtered);
+    brightnessMap = filtered;
+}
+
+// ------------------------------------------------------------
+// ------------ STATIC FUNCTIONS (PRIVATE) --------------------
+// ------------------------------------------------------------
+
+void ProjectorConfig::errorCallback(int error, const char* description) {
+    std::cerr << "GLFW Error (" << error << "): " << description << std::endl;
+}
+
+void ProjectorConfig::keyCallback(GLFWwindow *window, int key, int scandone, int action, int mods) {
+    if (action != GLFW_PRESS) return;
+
+    if (key == GLFW_KEY_ESCAPE)
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
+
+void ProjectorConfig::refreshCallback(GLFWwindow* window) {
+    auto projector = (ProjectorConfig*)glfwGetWindowUserPointer(window);
+    if (projector != nullptr) projector->redrawNeeded = true;
+}
+
+void ProjectorConfig::framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    auto projector = (ProjectorConfig*)glfwGetWindowUserPointer(window);
+    if (projector == nullptr) return;
+    std::lock_guard<std::mutex> lock(contentMutex);
+    projector->framebufferWidth = width;
+    projector->framebufferHeight = height;
+    projector->redrawNeeded = true;
+}
+
+void ProjectorConfig::presentContent(ProjectorConfig* projectors, uint count, Size warpSourceSize,
+                                     const std::function<bool()>& finished) {
+    // Configurations are copied around after their windows are created, so point the windows at the current ones
+    for (int i = 0; i < count; i++) {
+        glfwSetWindowUserPointer(projectors[i].window, &projectors[i]);
+        projectors[i].redrawNeeded = false;
+    }
+
+    // Every window gets a render thread that keeps its context current, so that the (vsync blocking) swaps of all
+    // projectors happen in parallel. The main thread only handles window events, as GLFW requires.
+    glfwMakeContextCurrent(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        sharedSourceSize = warpSourceSize;
+    }
+    uint64_t firstFrame;
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        firstFrame = requestedFrame;
+    }
+    FrameSchedule schedule(count, firstFrame);
+    std::vector<std::thread> renderThreads;
+    for (int i = 0; i < count; i++)
+        renderThreads.emplace_back(renderProjector, std::ref(projectors[i]), std::ref(schedule), warpSourceSize);
+    requestFrame();
+
+    bool shouldClose = false;
+    while (!shouldClose) {
+        // Sleep until input or window events, content and blend map updates wake the render threads directly
+        glfwWaitEvents();
+        bool redraw = false;
+        for (int i = 0; i < count; i++) {
+            projectors[i].shouldClose = glfwWindowShouldClose(projectors[i].window);
+            if (projectors[i].shouldClose) shouldClose = true;
+            std::lock_guard<std::mutex> lock(contentMutex);
+            redraw = redraw || projectors[i].redrawNeeded;
+            projectors[i].redrawNeeded = false;
+        }
+        if (redraw) requestFrame();
+        if (finished && finished()) break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        schedule.stopping = true;
+    }
+    frameRequested.notify_all();
+    schedule.barrier.close();
+    for (std::thread& renderThread : renderThreads)
+        renderThread.join();
+
+    std::lock_guard<std::mutex> lock(contentMutex);
+    sharedSourceSize = Size();
+    pendingSource.release();
+}
+
+void ProjectorConfig::renderProjector(ProjectorConfig& projector, FrameSchedule& schedule, Size warpSourceSize) {
+    glfwMakeContextCurrent(projector.window);
+
+    while (true) {
+        // presentedFrame only changes in a barrier completion, so all render threads see the same frames requested
+        {
+            std::unique_lock<std::mutex> lock(frameMutex);
+            frameRequested.wait(lock, [&] { return schedule.stopping || requestedFrame != schedule.presentedFrame; });
+            if (schedule.stopping) break;
+        }
+        // All projectors agree on the frame before taking their content, so no request is lost in between
+        if (!schedule.barrier.arriveAndWait([&] {
+            {
+                std::lock_guard<std::mutex> lock(frameMutex);
+                schedule.targetFrame = requestedFrame;
+            }
+            // The shared texture is uploaded once for all projectors before any of them draws from it,
+            // the fence makes the other contexts wait for the upload
+            Mat source;
+            {
+                std::lock_guard<std::mutex> lock(contentMutex);
+                source = pendingSource;
+                pendingSource.release();
+            }
+            if (!source.empty()) uploadSourceImage(source);
+        })) break;
+        uint64_t allocations = AllocationCounter::count();
+
+        Mat content;
+        {
+            std::lock_guard<std::mutex> lock(contentMutex);
+            if (projector.contentDirty) {
+                content = projector.pendingContent;
+                projector.pendingContent.release();
+                projector.contentDirty = false;
+            }
+        }
+        if (!content.empty() && warpSourceSize.empty())
+            projector.uploadFrame(content);
+        if (warpSourceSize.empty())
+            projector.drawStream(false);
+        else
+            projector.drawWarped(warpSourceSize, false);
+
+        // Swapped together, so that all projectors show the new frame from the same refresh on
+        auto arrival = std::chrono::steady_clock::now();
+        if (!schedule.barrier.arriveAndWait([&] {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            schedule.presentedFrame = schedule.targetFrame;
+        })) break;
+        double barrierMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - arrival).count();
+        Metrics::recordDuration("frameBarrier", projector.params.id, barrierMs);
+        projector.swapStats.barrierMs += barrierMs;
+        projector.swapBuffers();
+        projector.recordFrameAllocations(allocations);
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+void ProjectorConfig::uploadSourceImage(const Mat& img) {
+    Mat continuous = img.isContinuous() ? img : img.clone();
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, continuous.cols, continuous.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, continuous.ptr());
+    // The other (shared) contexts wait for the upload on the GPU instead of this thread waiting for it
+    std::lock_guard<std::mutex> lock(contentMutex);
+    if (textureUploaded != nullptr) glDeleteSync(textureUploaded);
+    textureUploaded = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+}
+
+// ------------------------------------------------------------
+// ------------ MEMBER FUNCTIONS (PUBLIC) ---------------------
+// ------------------------------------------------------------
+
+void ProjectorConfig::projectImage(const Mat& img, bool warp) {
+    uint64_t allocations = AllocationCounter::count();
+
+    // Create projector window
+    glfwMakeContextCurrent(window);
+
+    // Upload the image to the texture (warped and flipped vertically on the way)
+    uploadFrame(img, warp);
+    // Render
+    drawStream();
+    glfwPollEvents();
+    // Queried by managing application
+    shouldClose = glfwWindowShouldClose(window);
+
+    recordFrameAllocations(allocations);
+}
+
+void ProjectorConfig::recordFrameAllocations(uint64_t allocationsBefore) {
+    frameContext.frames++;
+    if (AllocationCounter::count() != allocationsBefore) frameContext.allocatingFrames++;
+    if (AllocationCounter::enabled() && frameContext.frames == UPLOAD_REPORT_INTERVAL) {
+        std::cout << "Projector " << params.id << ": " << frameContext.allocatingFrames << " of " << frameContext.frames
+                  << " frames allocated heap memory" << std::endl;
+        frameContext.frames = 0;
+        frameContext.allocatingFrames = 0;
+    }
+}
+
+void ProjectorConfig::updateContent(const Mat& img, bool warp) {
+    std::unique_lock<std::mutex> lock(contentMutex);
+    if (!sharedSourceSize.empty()) {
+        // The shader warps the shared texture for every projector, so it takes the unwarped source image
+        if (img.size() != sharedSourceSize || img.type() != CV_8UC3) {
+            std::cerr << "Content of " << img.cols << " x " << img.rows << " does not match the shared texture of "
+                      << sharedSourceSize.width << " x " << sharedSourceSize.height << " (BGR), ignored!" << std::endl;
+            return;
+        }
+        pendingSource = img;
+    } else {
+        lock.unlock();
+        Mat content = warp ? warpToBuffer(img) : img;
+        lock.lock();
+        pendingContent = content;
+        contentDirty = true;
+    }
+    lock.unlock();
+    // Wake up the render threads
+    requestFrame();
+}
+
+Mat ProjectorConfig::renderWarpedGPU(const Mat& img) {
+    glfwMakeContextCurrent(window);
+    uploadSourceImage(img);
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Without a homography the result stays black, like warpImage() without warp maps
+    if (!getHomography().empty()) {
+        glUseProgram(shader);
+        glUniform1i(warpEnabledLocation, GL_TRUE);
+        Matx33f fragToTexture = computeFragToTexture(img.size(), width, height);
+        glUniformMatrix3fv(fragToTextureLocation, 1, GL_TRUE, fragToTexture.val);
+        // Compared against warpImage(), which does not blend
+        bindBlendTexture(false);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindVertexArray(vertexArray);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+
+    // Read back the back buffer, OpenGL rows start at the bottom
+    Mat result(height, width, CV_8UC3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, result.ptr());
+    flip(result, result, 0);
+    return result;
+}
+
+double ProjectorConfig::verifyGPUWarp(const Mat& img, int tolerance) {
+    Mat gpu = renderWarpedGPU(img);
+    Mat cpu = warpImage(img);
+    if (gpu.size() != cpu.size()) {
+        std::cerr << "Framebuffer of projector " << params.id << " is " << gpu.cols << " x " << gpu.rows
+                  << ", expected " << cpu.cols << " x " << cpu.rows << "!" << std::endl;
+        return 1.0;
+    }
+
+    // Largest difference over all channels per pixel
+    Mat difference;
+    absdiff(gpu, cpu, difference);
+    difference = difference.reshape(1, (int)difference.total());
+    reduce(difference, difference, 1, REDUCE_MAX);
+    double maxDifference;
+    minMaxLoc(difference, nullptr, &maxDifference);
+    double failed = (double)countNonZero(difference > tolerance) / difference.total();
+    std::cout << "GPU warp of projector " << params.id << ": " << failed * 100.0 << " % of pixels differ by more than "
+              << tolerance << " (max difference " << maxDifference << ")" << std::endl;
+    return failed;
+}
+
+bool ProjectorConfig::openWindow(const ProjectorConfig* shared, bool visible) {
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+    bool success = initWindow((shared == nullptr) ? nullptr : shared->window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    return success;
+}
+
+// ------------------------------------------------------------
+// ------------ MEMBER FUNCTIONS (PRIVATE) ---------------------
+// ------------------------------------------------------------
+
+bool ProjectorConfig::initWindow(GLFWwindow* shared) {
+    // Get monitor
+    int count;
+    GLFWmonitor** monitors = glfwGetMonitors(&count);
+
+    // Create window
+    window = glfwCreateWindow(params.width, params.height, "Projector", nullptr, shared);
+    if (!window) {
+        std::cerr << "Could not create GLFW window!" << std::endl;
+        return false;
+    }
+    // Set window position
+    glfwSetWindowPos(window,params.posX, params.posY);
+    // Set event callbacks
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, refreshCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+
+    glfwMakeContextCurrent(window);
+
+    // For retrieval during static callback functions
+    glfwSetWindowUserPointer(window, this);
+
+    // Either we have shared state or we need to create it
+    if (shared == nullptr) {
+        std::cout << "No shared OpenGL context, creating..." << std::endl;
+        // glad: load all OpenGL function pointers
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cerr << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+
+        // Prepare texture
+        glEnable(GL_TEXTURE_2D);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        // Create buffer objects
+        VBO = createVertexBuffer();
+        EBO = createElementBuffer();
+    }
+    // Buffers objects only need to be created once and are shared, but context state needs to be set for each context
+    vertexArray = createVertexArray(VBO, EBO);
+    // Each window links its own program, so its uniforms are not overwritten by other render threads
+    shader = createShaderProgram();
+    warpEnabledLocation = glGetUniformLocation(shader, "warpEnabled");
+    fragToTextureLocation = glGetUniformLocation(shader, "fragToTexture");
+    blendEnabledLocation = glGetUniformLocation(shader, "blendEnabled");
+    // Frames are sampled from texture unit 0, the blend map from unit 1
+    glUseProgram(shader);
+    glUniform1i(glGetUniformLocation(shader, "ourTexture"), 0);
+    glUniform1i(glGetUniformLocation(shader, "blendTexture"), 1);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+    // Streaming texture and pixel unpack buffers of this projector, storage is allocated on the first upload
+    glGenTextures(1, &streamTexture);
+    glBindTexture(GL_TEXTURE_2D, streamTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glGenBuffers(UPLOAD_BUFFER_COUNT, uploadBuffers);
+
+    return true;
+}
+
+void ProjectorConfig::uploadFrame(const Mat& frame, bool warp) {
+    CV_Assert(frame.depth() == CV_8U && (frame.channels() == 1 || frame.channels() == 3 || frame.channels() == 4));
+    auto start = std::chrono::steady_clock::now();
+    bool warmWarp = warp && prepareUploadMaps(frame.size());
+    double prepareMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Size size = warp ? Size((int)params.width, (int)params.height) : frame.size();
+
+    // Color frames are uploaded as they are, gray ones are expanded by the texture swizzle
+    GLenum format = (frame.channels() == 1) ? GL_RED : (frame.channels() == 3) ? GL_BGR : GL_BGRA;
+    glBindTexture(GL_TEXTURE_2D, streamTexture);
+    // Texture storage only changes with the resolution or pixel format (immutable storage needs OpenGL 4.2)
+    if (size != frameContext.streamSize || frame.type() != frameContext.streamType) {
+        GLint internalFormat = (frame.channels() == 1) ? GL_R8 : (frame.channels() == 3) ? GL_RGB8 : GL_RGBA8;
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.width, size.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        GLint graySwizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        GLint colorSwizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, (frame.channels() == 1) ? graySwizzle : colorSwizzle);
+        frameContext.streamSize = size;
+        frameContext.streamType = frame.type();
+    }
+
+    // Write into the next buffer of the ring while the driver may still read the previous one
+    const size_t rowBytes = (size_t)size.width * frame.elemSize();
+    const size_t frameBytes = rowBytes * size.height;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[uploadIndex]);
+    // Orphan the buffer's old storage instead of waiting for pending reads from it
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)frameBytes, nullptr, GL_STREAM_DRAW);
+    auto* mapped = (uchar*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)frameBytes,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != nullptr) {
+        // OpenGL expects the bottom row first, so the vertical flip happens on the way into the buffer
+        Mat target(size, frame.type(), mapped);
+        if (!warp) {
+            for (int y = 0; y < frame.rows; y++)
+                std::memcpy(mapped + (size_t)(frame.rows - 1 - y) * rowBytes, frame.ptr(y), rowBytes);
+        } else {
+            auto warpStart = std::chrono::steady_clock::now();
+            if (frameContext.uploadMap1.empty())
+                target.setTo(Scalar::all(0));
+            else
+                remap(frame, target, frameContext.uploadMap1, frameContext.uploadMap2, INTER_LINEAR, BORDER_CONSTANT);
+            recordWarpTime(warmWarp, prepareMs + std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - warpStart).count());
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        // Source is the bound unpack buffer, the upload is asynchronous
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width, size.height, format, GL_UNSIGNED_BYTE, nullptr);
+    } else {
+        std::cerr << "Could not map upload buffer of projector " << params.id << "!" << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    uploadIndex = (uploadIndex + 1) % UPLOAD_BUFFER_COUNT;
+
+    double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Metrics::recordDuration("upload", params.id, uploadMs);
+    uploadStats.frames++;
+    uploadStats.totalMs += uploadMs;
+    uploadStats.maxMs = std::max(uploadStats.maxMs, uploadMs);
+    if (uploadStats.frames == UPLOAD_REPORT_INTERVAL) {
+        std::cout << "Projector " << params.id << " uploads: " << uploadStats.totalMs / uploadStats.frames
+                  << " ms average, " << uploadStats.maxMs << " ms max over " << uploadStats.frames << " frames" << std::endl;
+        uploadStats = UploadStats();
+    }
+}
+
+bool ProjectorConfig::prepareUploadMaps(Size sourceSize) {
+    bool warm = updateWarpMap(sourceSize);
+    if (frameContext.uploadMapKey != warpMapKey) {
+        if (warpMap1.empty()) {
+            frameContext.uploadMap1.release();
+            frameContext.uploadMap2.release();
+        } else {
+            flip(warpMap1, frameContext.uploadMap1, 0);
+            flip(warpMap2, frameContext.uploadMap2, 0);
+        }
+        frameContext.uploadMapKey = warpMapKey;
+    }
+    return warm;
+}
+
+void ProjectorConfig::drawWarped(Size sourceSize, bool swap) {
+    glfwMakeContextCurrent(window);
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        width = framebufferWidth;
+        height = framebufferHeight;
+        // Server side wait, the shared texture may have been uploaded from another context
+        if (textureUploaded != nullptr) glWaitSync(textureUploaded, 0, GL_TIMEOUT_IGNORED);
+    }
+    glViewport(0, 0, width, height);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Nothing to warp with, the projector stays black like with the CPU warp
+    if (getHomography().empty()) {
+        if (swap) swapBuffers();
+        return;
+    }
+    glUseProgram(shader);
+    glUniform1i(warpEnabledLocation, GL_TRUE);
+    Matx33f fragToTexture = computeFragToTexture(sourceSize, width, height);
+    glUniformMatrix3fv(fragToTextureLocation, 1, GL_TRUE, fragToTexture.val);
+    bindBlendTexture(true);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(vertexArray);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+    if (swap) swapBuffers();
+}
+
+void ProjectorConfig::drawStream(bool swap) {
+    glfwMakeContextCurrent(window);
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        width = framebufferWidth;
+        height = framebufferHeight;
+    }
+    glViewport(0, 0, width, height);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(shader);
+    glUniform1i(warpEnabledLocation, GL_FALSE);
+    bindBlendTexture(true);
+    glBindTexture(GL_TEXTURE_2D, streamTexture);
+    glBindVertexArray(vertexArray);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+    // Swap front and back buffers
+    if (swap) swapBuffers();
+}
+
+void ProjectorConfig::swapBuffers() {
+    auto start = std::chrono::steady_clock::now();
+    glfwSwapBuffers(window);
+    auto now = std::chrono::steady_clock::now();
+    double swapMs = std::chrono::duration<double, std::milli>(now - start).count();
+    Metrics::recordDuration("swap", params.id, swapMs);
+    swapStats.frames++;
+    swapStats.totalMs += swapMs;
+    swapStats.maxMs = std::max(swapStats.maxMs, swapMs);
+    if (swapStats.frames == SWAP_REPORT_INTERVAL) {
+        std::cout << "Projector " << params.id << " swaps: " << swapStats.totalMs / swapStats.frames << " ms average, "
+                  << swapStats.maxMs << " ms max, " << swapStats.barrierMs / swapStats.frames
+                  << " ms average wait for the other projectors over " << swapStats.frames << " frames" << std::endl;
+        swapStats = SwapStats();
+    }
+
+    if (!Metrics::isEnabled()) return;
+    if (frameContext.lastSwap != std::chrono::steady_clock::time_point())
+        Metrics::recordDuration("frameInterval", params.id,
+                                std::chrono::duration<double, std::milli>(now - frameContext.lastSwap).count(), false);
+    frameContext.lastSwap = now;
+}
+
+void ProjectorConfig::bindBlendTexture(bool enabled) {
+    glActiveTexture(GL_TEXTURE1);
+    std::unique_lock<std::mutex> lock(blendMutex);
+    if (enabled && blendDirty) {
+        if (blendTexture == 0) {
+            glGenTextures(1, &blendTexture);
+            glBindTexture(GL_TEXTURE_2D, blendTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        }
+        // Flipped vertically like the streamed frames, so both are sampled at texCoord
+        Mat flipped;
+        flip(blendMap, flipped, 0);
+        glBindTexture(GL_TEXTURE_2D, blendTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, flipped.cols, flipped.rows, 0, GL_RED, GL_UNSIGNED_BYTE, flipped.ptr());
+        blendDirty = false;
+    }
+    lock.unlock();
+    bool blend = enabled && blendTexture != 0;
+    glBindTexture(GL_TEXTURE_2D, blend ? blendTexture : 0);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(blendEnabledLocation, blend ? GL_TRUE : GL_FALSE);
+}
+
+Matx33d ProjectorConfig::computeFragToTexture(Size sourceSize, int framebufferWidth, int framebufferHeight) {
+    // Window coordinates (origin bottom left, pixel centers at .5) to projector pixels (origin top left),
+    // this replaces the vertical flip before uploading
+    double scaleX = (double)params.width / framebufferWidth;
+    double scaleY = (double)params.height / framebufferHeight;
+    Matx33d fragToProjector(scaleX, 0, -0.5,
+                            0, -scaleY, params.height - 0.5,
+                            0, 0, 1);
+    // warpPerspective() samples the source at the inverse homography
+    Matx33d projectorToCamera = Matx33d(getHomography()).inv();
+    // Camera pixels of the horizontally flipped image to texture coordinates of the unflipped one,
+    // this replaces the horizontal flip in warpImage(). The source is stretched over the camera image like there.
+    double w = sourceSize.width, h = sourceSize.height;
+    Matx33d cameraToTexture(-1.0 / CAMWIDTH, 0, (w - 0.5) / w,
+                            0, 1.0 / CAMHEIGHT, 0.5 / h,
+                            0, 0, 1);
+    return cameraToTexture * projectorToCamera * fragToProjector;
+}
+
+// ------------------------------------------------------------
+// ------------------------- CONSTRUCTORS ---------------------
+// ------------------------------------------------------------
+ProjectorConfig::ProjectorConfig(uint id, const ProjectorConfig* shared) : window(nullptr), shouldClose(false), patternWindowOpen(false),
+    streamTexture(0), uploadBuffers{}, uploadIndex(0), contentDirty(false), warpBufferIndex(0), redrawNeeded(false),
+    vertexArray(0), shader(0), warpEnabledLocation(-1), fragToTextureLocation(-1), blendEnabledLocation(-1),
+    framebufferWidth(0), framebufferHeight(0),
+    warpMode(WARP_HOMOGRAPHY), warpMapKey(0), c2pHash(0), homographyFailed(false),
+    blendTexture(0), blendDirty(false) {
+    int count;
+    auto monitors = glfwGetMonitors(&count);
+    if (id >= count) {
+        std::cerr << "Tried initializing projector with ID " << id << ", but that monitor does not exist!" << std::endl;
+    }
+
+    GLFWmonitor* monitor = monitors[id];
+    const GLFWvidmode* vidMode = glfwGetVideoMode(monitor);
+    int xPos, yPos;
+    glfwGetMonitorPos(monitor, &xPos, &yPos);
+    params = ProjectorParams(id, vidMode->width, vidMode->height, xPos, yPos);
+    std::cout << "Creating full screen window on monitor #" << id << " (" << vidMode->width << " x " << vidMode->height << " px) at "
+              << xPos << "/" << yPos << std::endl;
+
+    initWindow((shared == nullptr) ? nullptr : shared->window);
+}
+
+// ------------------------------------------------------------
+// ------- OPENGL HELPER FUNCTIONS (PRIVATE) ------------------
+// ------------------------------------------------------------
+
+unsigned int ProjectorConfig::createVertexBuffer() {
+    // Vertex data in 3D normalized device coordinates (-1,1)
+    // Everything outside (-1,1) range AFTER vertex shader, will be clipped!
+    float vertices[] = {
+            // positions                      // texture coords
+            1.0f,  1.0f, 0.0f,   1.0f, 1.0f,   // top right
+            1.0f, -1.0f, 0.0f,   1.0f, 0.0f,   // bottom right
+            -1.0f, -1.0f, 0.0f,   0.0f, 0.0f,   // bottom left
+            -1.0f,  1.0f, 0.0f,   0.0f, 1.0f    // top left
+    };
+
+    // Create OpenGL buffer object and save its ID
+    unsigned int VBO;
+    glGenBuffers(1, &VBO);
+    // Bind to target of specific type "GL_ARRAY_BUFFER" for vertex buffer objects
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // Because of binding calls to "GL_ARRAY_BUFFER" will now redirect to our bound "VBO" buffer, where we place the data
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                 GL_STATIC_DRAW); // STATIC_DRAW = data set once, used often
+    // Unbind buffer
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return VBO;
+}
+
+unsigned int ProjectorConfig::createElementBuffer() {
+    // Index data pointing to the vertices in VBO
+    unsigned int indices[] = {
+            0, 1, 3, // first triangle
+            1, 2, 3  // second triangle
+    };
+
+    // Create OpenGL Element Buffer object and save its ID
+    unsigned int EBO;
+    glGenBuffers(1, &EBO);
+    // Bind and set the buffer data to the indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // Unbind
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return EBO;
+}
+
+unsigned int ProjectorConfig::createVertexArray(unsigned int vertexBuffer, unsigned int elementBuffer) {
+    // Create OpenGL vertex array object and save its ID
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+    // Bind the vertex array
+    glBindVertexArray(VAO); {
+        // Bind the buffers belonging to this vertex array
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);            // Contains the vertex data
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);   // Contains the order in which to visit vertices
+        // Set Vertex Attribute Pointers (tells the VAO how to use currently bound VBO data)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);// Set Vertex Attribute Pointers (tells the VAO how to use currently bound VBO data)
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        // Unbind the VBO
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // Unbind the VAO
+    glBindVertexArray(0);
+    // Unbind the EBO after(!) the VAO so the binding is saved
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    return VAO;
+}
+
+unsigned int ProjectorConfig::compileShader(const char* shaderSource, int shaderType) {
+    unsigned int shader;
+    shader = glCreateShader(shaderType);
+    // Attach shader source code and compile
+    glShaderSource(shader, 1, &shaderSource, nullptr);
+    glCompileShader(shader);
+    // Check if compilation was successful
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "ERROR! Shader compilation failed. Log:\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+unsigned int ProjectorConfig::createShaderProgram() {
+    unsigned int vertexShader = compileShader(VERTEXSHADERSOURCE, GL_VERTEX_SHADER);
+    unsigned int fragmentShader = compileShader(FRAGMENTSHADERSOURCE, GL_FRAGMENT_SHADER);
+
+    // Create an OpenGL shader program object and save its ID
+    unsigned int shaderProgram;
+    shaderProgram = glCreateProgram();
+    // Attach shaders and link
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+    // Check for link errors
+    int success;
+    char infoLog[512];
+    glGetProgramiv(shaderProgram, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cerr << "ERROR! Shader program compilation failed. Log:\n" << infoLog << std::endl;
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return shaderProgram;
+}
@@ -0,0 +1,22 @@
+//
+// Projectors and camera the calibration talks to, replaceable by a simulation (see VirtualRig).
+//
+
+#ifndef CLIMBPM_RIG_H
+#define CLIMBPM_RIG_H
+
+#include <opencv2/core.hpp>
+
+using namespace cv;
+
+class Rig {
+public:
+    virtual ~Rig() = default;
+    // Shows image on the projector with the given id until the next call for that projector
+    virtual void showPattern(uint projectorId, const Mat& image) = 0;
+    // Returns a new camera frame (BGR, ProjectorConfig::CAMWIDTH x ProjectorConfig::CAMHEIGHT)
+    virtual Mat captureFrame() = 0;
+};
+
+
+#endif //CLIMBPM_RIG_H
@@ -0,0 +1,292 @@
+//
+// Closed-loop shadow compensation: watches the camera while projecting and lets other projectors fill in where a
+// climber blocks one of them.
+//
+
+#include "ShadowCompensator.h"
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+#include "Metrics.h"
+
+ShadowCompensator::ShadowCompensator(ProjectorConfig* projectors, int count)
+: projectors(projectors), count(count), ready(false), compensating(false), tileColumns(0), tileRows(0),
+  running(false) {
+    for (int i = 0; i < count; i++) {
+        if (projectors[i].contributionMatrix.empty() || projectors[i].white.empty()) {
+            std::cerr << "Projector " << projectors[i].params.id << " has no contributions, call "
+                      << "ProjectorConfig::computeContributions() before compensating shadows!" << std::endl;
+            return;
+        }
+    }
+
+    // Everything the detection needs is kept downscaled, only the tiles that change are touched at full resolution
+    smallSize = Size(ProjectorConfig::CAMWIDTH / SHADOW_DOWNSCALE, ProjectorConfig::CAMHEIGHT / SHADOW_DOWNSCALE);
+    for (int i = 0; i < count; i++) {
+        ProjectorConfig& projector = projectors[i];
+        baseContribution.push_back(projector.contributionMatrix.clone());
+        Mat white, valid, light, weight;
+        projector.white.convertTo(white, CV_32F);
+        projector.c2pValid.convertTo(valid, CV_32F, 1.0 / 255.0);
+        resize(white.mul(valid), light, smallSize, 0, 0, INTER_AREA);
+        resize(projector.contributionMatrix, weight, smallSize, 0, 0, INTER_AREA);
+        lightSmall.push_back(light);
+        weightSmall.push_back(weight);
+        blocked.push_back(Mat::zeros(smallSize, CV_8UC1));
+        compensated.push_back(Mat::zeros(smallSize, CV_8UC1));
+        detected.push_back(Mat::zeros(smallSize, CV_8UC1));
+        applied.push_back(Mat::zeros(smallSize, CV_8UC1));
+    }
+    contentSmall = Mat(smallSize, CV_32F, Scalar(1.0f));
+    projectorLight.resize(count);
+
+    tileColumns = (ProjectorConfig::CAMWIDTH + SHADOW_TILE_SIZE - 1) / SHADOW_TILE_SIZE;
+    tileRows = (ProjectorConfig::CAMHEIGHT + SHADOW_TILE_SIZE - 1) / SHADOW_TILE_SIZE;
+    tileUpdates.assign(tileColumns * tileRows, std::chrono::steady_clock::time_point());
+    dirtyTiles.assign(tileColumns * tileRows, 0);
+    ready = true;
+}
+
+ShadowCompensator::~ShadowCompensator() {
+    stop();
+}
+
+void ShadowCompensator::setContent(const Mat& img) {
+    if (!ready) return;
+    Mat gray, mirrored, smallArea, brightness;
+    if (img.channels() == 3)
+        cvtColor(img, gray, COLOR_BGR2GRAY);
+    else
+        gray = img;
+    // The warp maps sample the source mirrored (see warpImage()), so camera pixel (x, y) shows source pixel (W-1-x, y)
+    flip(gray, mirrored, 1);
+    resize(mirrored, smallArea, smallSize, 0, 0, INTER_AREA);
+    smallArea.convertTo(brightness, CV_32F, 1.0 / 255.0);
+    // A new matrix each time, so the compensation thread can keep using the previous one
+    std::lock_guard<std::mutex> lock(contentMutex);
+    contentSmall = brightness;
+}
+
+// ------------------------------------------------------------
+// ------------------------- LOOP -----------------------------
+// ------------------------------------------------------------
+
+void ShadowCompensator::start() {
+    if (!ready || running) return;
+    if (ProjectorConfig::rig == nullptr && !ProjectorConfig::camera.isOpened())
+        ProjectorConfig::initCamera();
+    running = true;
+    thread = std::thread(&ShadowCompensator::run, this);
+}
+
+void ShadowCompensator::stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+    if (!compensating) return;
+
+    for (int i = 0; i < count; i++) {
+        baseContribution[i].copyTo(projectors[i].contributionMatrix);
+        projectors[i].computeBlendMap();
+        resize(baseContribution[i], weightSmall[i], smallSize, 0, 0, INTER_AREA);
+        blocked[i].setTo(0);
+        compensated[i].setTo(0);
+    }
+    compensating = false;
+    if (updateCallback) updateCallback();
+}
+
+void ShadowCompensator::run() {
+    while (running) {
+        CameraFrame frame;
+        if (!ProjectorConfig::getCameraFrame(frame)) {
+            std::cerr << "Camera returned no image, shadow compensation stopped!" << std::endl;
+            break;
+        }
+        processFrame(frame);
+    }
+}
+
+void ShadowCompensator::processFrame(const Mat& frame) {
+    CameraFrame timed;
+    timed.image = frame;
+    timed.timestamp = std::chrono::steady_clock::now();
+    processFrame(timed);
+}
+
+void ShadowCompensator::processFrame(const CameraFrame& cameraFrame) {
+    if (!ready) return;
+    const Mat& frame = cameraFrame.image;
+    const auto grabbed = cameraFrame.timestamp;
+    if (frame.cols != (int)ProjectorConfig::CAMWIDTH || frame.rows != (int)ProjectorConfig::CAMHEIGHT) {
+        std::cerr << "Camera frame of " << frame.cols << "x" << frame.rows << " does not match the calibration!" << std::endl;
+        return;
+    }
+    if (frame.channels() == 3)
+        cvtColor(frame, gray, COLOR_BGR2GRAY);
+    else
+        gray = frame;
+    resize(gray, observedGray, smallSize, 0, 0, INTER_AREA);
+    observedGray.convertTo(observed, CV_32F);
+    Mat content;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        content = contentSmall;
+    }
+
+    detectShadows(observed, content);
+
+    // Single pixels are noise, the dilation covers the penumbra at the shadow's edge
+    for (int i = 0; i < count; i++) {
+        morphologyEx(detected[i], detected[i], MORPH_OPEN, Mat());
+        for (int tileY = 0; tileY < tileRows; tileY++) {
+            for (int tileX = 0; tileX < tileColumns; tileX++) {
+                // The projectors may not have shown the last update yet when the frame was grabbed,
+                // the camera would see the old shadows again
+                double sinceUpdateMs = std::chrono::duration<double, std::milli>(grabbed - tileUpdates[tileY * tileColumns + tileX]).count();
+                if (sinceUpdateMs < SHADOW_SETTLE_MS)
+                    blocked[i](smallTile(tileX, tileY)).copyTo(detected[i](smallTile(tileX, tileY)));
+            }
+        }
+        std::swap(blocked[i], detected[i]);
+        dilate(blocked[i], applied[i], Mat());
+    }
+
+    // Tiles where any projector's shadow changed
+    uint updatedTiles = 0;
+    for (int tileY = 0; tileY < tileRows; tileY++) {
+        for (int tileX = 0; tileX < tileColumns; tileX++) {
+            Rect smallArea = smallTile(tileX, tileY);
+            uchar dirty = 0;
+            for (int i = 0; i < count && !dirty; i++)
+                dirty = norm(applied[i](smallArea), compensated[i](smallArea), NORM_INF) > 0;
+            dirtyTiles[tileY * tileColumns + tileX] = dirty;
+            updatedTiles += dirty;
+        }
+    }
+    std::swap(applied, compensated);
+
+    if (updatedTiles > 0) {
+        // Neighbouring dirty tiles of a row are updated together, which keeps the number of blend map updates low
+        for (int tileY = 0; tileY < tileRows; tileY++) {
+            for (int tileX = 0; tileX < tileColumns; tileX++) {
+                if (!dirtyTiles[tileY * tileColumns + tileX]) continue;
+                int runEnd = tileX;
+                while (runEnd + 1 < tileColumns && dirtyTiles[tileY * tileColumns + runEnd + 1]) runEnd++;
+                Rect runArea = Rect(tileX * SHADOW_TILE_SIZE, tileY * SHADOW_TILE_SIZE,
+                                (runEnd - tileX + 1) * SHADOW_TILE_SIZE, SHADOW_TILE_SIZE)
+                           & Rect(0, 0, ProjectorConfig::CAMWIDTH, ProjectorConfig::CAMHEIGHT);
+                updateTiles(runArea);
+                for (int i = 0; i < count; i++)
+                    projectors[i].updateBlendMap(runArea);
+                for (int x = tileX; x <= runEnd; x++)
+                    tileUpdates[tileY * tileColumns + x] = std::chrono::steady_clock::now();
+                tileX = runEnd;
+            }
+        }
+        // Includes the frame's wait in the camera ring, the blend maps are uploaded with the next drawn frame
+        double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - grabbed).count();
+        Metrics::recordDuration("shadow", 0, latencyMs);
+        stats.updatedFrames++;
+        stats.totalMs += latencyMs;
+        stats.maxMs = std::max(stats.maxMs, latencyMs);
+        compensating = true;
+        if (updateCallback) updateCallback();
+    }
+
+    Metrics::count("shadowTiles", 0, updatedTiles);
+    stats.frames++;
+    stats.updatedTiles += updatedTiles;
+    if (stats.frames == SHADOW_REPORT_INTERVAL) {
+        std::cout << "Shadow compensation: " << stats.updatedTiles << " tiles updated in " << stats.updatedFrames
+                  << " of " << stats.frames << " frames";
+        if (stats.updatedFrames > 0)
+            std::cout << ", " << stats.totalMs / stats.updatedFrames << " ms average, " << stats.maxMs
+                      << " ms max from grab to blend map update";
+        std::cout << std::endl;
+        stats = ShadowStats();
+    }
+}
+
+// ------------------------------------------------------------
+// ------------------------- DETECTION ------------------------
+// ------------------------------------------------------------
+
+void ShadowCompensator::detectShadows(const Mat& observed, const Mat& content) {
+    for (int y = 0; y < smallSize.height; y++) {
+        const float* observedRow = observed.ptr<float>(y);
+        const float* contentRow = content.ptr<float>(y);
+        for (int x = 0; x < smallSize.width; x++) {
+            // Light each projector should add to the pixel with its current contribution
+            float expected = 0.0f;
+            for (int i = 0; i < count; i++) {
+                projectorLight[i] = contentRow[x] * weightSmall[i].at<float>(y, x) * lightSmall[i].at<float>(y, x);
+                expected += projectorLight[i];
+            }
+            float missing = expected - observedRow[x];
+
+            // Too little light to tell, the projector keeps its state. Blocked projectors stay blocked as long as
+            // their (probe) light is missing, whatever is missing beyond that is the brightest open projector's.
+            int candidate = -1;
+            for (int i = 0; i < count; i++) {
+                uchar& state = detected[i].at<uchar>(y, x);
+                state = blocked[i].at<uchar>(y, x);
+                if (projectorLight[i] < SHADOW_MIN_SIGNAL) continue;
+                if (state) {
+                    if (missing >= 0.5f * projectorLight[i])
+                        missing -= projectorLight[i];
+                    else
+                        state = 0;
+                }
+                else if (candidate < 0 || projectorLight[i] > projectorLight[candidate]) {
+                    candidate = i;
+                }
+            }
+            if (candidate >= 0 && missing >= 0.5f * projectorLight[candidate]
+                && missing <= 1.5f * projectorLight[candidate] + SHADOW_MIN_SIGNAL)
+                detected[candidate].at<uchar>(y, x) = 255;
+        }
+    }
+}
+
+// ------------------------------------------------------------
+// ------------------------- CONTRIBUTIONS --------------------
+// ------------------------------------------------------------
+
+Rect ShadowCompensator::smallTile(int tileX, int tileY) const {
+    const int size = SHADOW_TILE_SIZE / SHADOW_DOWNSCALE;
+    return Rect(tileX * size, tileY * size, size, size) & Rect(Point(0, 0), smallSize);
+}
+
+void ShadowCompensator::updateTiles(Rect area) {
+    for (int y = area.y; y < area.y + area.height; y++) {
+        int smallY = std::min(y / SHADOW_DOWNSCALE, smallSize.height - 1);
+        for (int x = area.x; x < area.x + area.width; x++) {
+            int smallX = std::min(x / SHADOW_DOWNSCALE, smallSize.width - 1);
+            // Light of the blocked and the open projectors without compensation
+            float blockedLight = 0.0f, openLight = 0.0f;
+            for (int i = 0; i < count; i++) {
+                float light = baseContribution[i].at<float>(y, x) * projectors[i].white.at<uchar>(y, x);
+                if (compensated[i].at<uchar>(smallY, smallX))
+                    blockedLight += light;
+                else
+                    openLight += light;
+            }
+            // Open projectors make up for the light the blocked ones hold back, as far as they can
+            float gain = (openLight > 0.0f) ? (openLight + (1.0f - SHADOW_PROBE_WEIGHT) * blockedLight) / openLight : 1.0f;
+            for (int i = 0; i < count; i++) {
+                float base = baseContribution[i].at<float>(y, x);
+                projectors[i].contributionMatrix.at<float>(y, x) = compensated[i].at<uchar>(smallY, smallX)
+                                                                   ? SHADOW_PROBE_WEIGHT * base
+                                                                   : std::min(1.0f, base * gain);
+            }
+        }
+    }
+
+    // The detection expects the light of the new contributions
+    Rect smallArea = Rect(area.x / SHADOW_DOWNSCALE, area.y / SHADOW_DOWNSCALE,
+                      (area.width + SHADOW_DOWNSCALE - 1) / SHADOW_DOWNSCALE,
+                      (area.height + SHADOW_DOWNSCALE - 1) / SHADOW_DOWNSCALE) & Rect(Point(0, 0), smallSize);
+    for (int i = 0; i < count; i++) {
+        Mat target = weightSmall[i](smallArea);
+        resize(projectors[i].contributionMatrix(area), target, smallArea.size(), 0, 0, INTER_AREA);
+    }
+}
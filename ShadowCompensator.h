@@ -0,0 +1,104 @@
+//
+// Closed-loop shadow compensation: watches the camera while projecting and lets other projectors fill in where a
+// climber blocks one of them.
+//
+
+#ifndef CLIMBPM_SHADOWCOMPENSATOR_H
+#define CLIMBPM_SHADOWCOMPENSATOR_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "ProjectorConfig.h"
+
+// Shadows are detected on camera frames downscaled by this factor
+#define SHADOW_DOWNSCALE 4
+// Contributions are recomputed in tiles of this size where the shadows changed (camera pixels, multiple of SHADOW_DOWNSCALE)
+#define SHADOW_TILE_SIZE 32
+// Share of its contribution a blocked projector keeps, so that the camera sees when the occluder has left
+#define SHADOW_PROBE_WEIGHT 0.2f
+// Least light a projector has to add to a pixel for its shadow to be told apart from noise (gray levels)
+#define SHADOW_MIN_SIGNAL 12.0f
+// After an update, a tile keeps its shadows until the projectors show the new contributions (ms)
+#define SHADOW_SETTLE_MS 50.0
+// Print the compensation latency every this many camera frames
+#define SHADOW_REPORT_INTERVAL 300
+
+// Latency from grabbing a camera frame to requesting the blend map updates it caused (frames with updates only)
+struct ShadowStats {
+    uint frames;
+    uint updatedFrames;
+    uint updatedTiles;
+    double totalMs;
+    double maxMs;
+    ShadowStats() : frames(0), updatedFrames(0), updatedTiles(0), totalMs(0.0), maxMs(0.0) {}
+};
+
+// Needs calibrated projectors with computed contributions. Runs on its own thread next to the static
+// ProjectorConfig::projectImage() or a VideoPlayer, which draw the changed contributions.
+class ShadowCompensator {
+public:
+    ShadowCompensator(ProjectorConfig* projectors, int count);
+    ~ShadowCompensator();
+
+    // What is being projected (source image, any size), shadows are found where the camera sees less than it should
+    void setContent(const Mat& img);
+    // Called from the compensation thread after contributions changed (the render threads are woken up anyway)
+    void setUpdateCallback(std::function<void()> callback) { updateCallback = std::move(callback); }
+
+    // Opens the camera if needed and compensates every frame until stop()
+    void start();
+    // Stops and restores the contributions without compensation
+    void stop();
+
+    // One step of the loop on a camera frame (BGR or gray, camera resolution), latencies count from its timestamp
+    void processFrame(const CameraFrame& frame);
+    // Same for a frame without timestamp, taken to be grabbed now
+    void processFrame(const Mat& frame);
+
+private:
+    ProjectorConfig* projectors;
+    int count;
+    bool ready;
+    Size smallSize;
+    // Contributions computed without shadows (camera space, CV_32F)
+    std::vector<Mat> baseContribution;
+    // Downscaled light of each projector at full white (gray levels) and its current contribution (CV_32F)
+    std::vector<Mat> lightSmall;
+    std::vector<Mat> weightSmall;
+    // Downscaled pixels each projector was detected as blocked at and, dilated, the ones its contributions were
+    // lowered at (CV_8UC1, 0 or 255)
+    std::vector<Mat> blocked;
+    std::vector<Mat> compensated;
+    // Contributions differ from baseContribution
+    bool compensating;
+    // Brightness of the content per downscaled pixel (CV_32F, 0..1)
+    Mat contentSmall;
+    std::mutex contentMutex;
+    // When each tile was last updated
+    std::vector<std::chrono::steady_clock::time_point> tileUpdates;
+    int tileColumns, tileRows;
+    std::function<void()> updateCallback;
+    std::thread thread;
+    std::atomic<bool> running;
+    ShadowStats stats;
+    // Reused by every frame
+    Mat gray, observedGray, observed;
+    std::vector<Mat> detected, applied;
+    std::vector<float> projectorLight;
+    std::vector<uchar> dirtyTiles;
+
+    // Per projector, which downscaled pixels it is blocked at in the frame (into detected)
+    void detectShadows(const Mat& observed, const Mat& content);
+    // Downscaled pixels of a tile
+    Rect smallTile(int tileX, int tileY) const;
+    // Recomputes the contributions of all projectors inside the area (camera pixels) from the compensated shadows
+    void updateTiles(Rect area);
+    void run();
+};
+
+
+#endif //CLIMBPM_SHADOWCOMPENSATOR_H
@@ -0,0 +1,292 @@
+//
+// End-to-end calibration on a simulated rig (ClimbPM_sim). Projects and captures the graycodes through VirtualRig,
+// runs decoding, homography fitting and contributions like main() and writes timings and accuracy as JSON:
+//   ClimbPM_sim [--projectors <n>] [--projector <w>x<h>] [--camera <w>x<h>] [--mode sequential|multiplexed]
+//               [--noise <sigma>] [--blur <sigma>] [--ambient <level>] [--holds <n>] [--relief <px>]
+//               [--seed <n>] [--output <file.json>] [--trace <trace.json>]
+//
+
+#include "ProjectorConfig.h"
+#include "VirtualRig.h"
+#include <functional>
+
+// Share of a projector's grid cell it overlaps into its neighbours
+#define SIM_OVERLAP 0.1
+// Random displacement of the footprint corners (share of the grid cell)
+#define SIM_CORNER_JITTER 0.04
+// Homography errors are measured on every n-th camera pixel
+#define SIM_HOMOGRAPHY_STEP 4
+
+struct SimStage {
+    std::string stage;
+    // 0 for stages covering all projectors
+    int projector;
+    double ms;
+};
+
+struct SimAccuracy {
+    int projector;
+    // Camera pixels the projector lights directly and the share of them that got mapped
+    int truthPixels;
+    double coverage;
+    // Mapped camera pixels the projector does not light directly
+    int falseMapped;
+    // Distance between decoded and true projector pixel (projector pixels)
+    double c2pErrorMean, c2pErrorMedian, c2pErrorP95;
+    // Distance between the homography's and the true projector pixel (projector pixels)
+    double homographyErrorMean, homographyErrorP95;
+};
+
+struct SimOptions {
+    int projectorCount;
+    Size projector;
+    bool multiplexed;
+    double reliefAmplitude;
+    VirtualCameraParams camera;
+    SimOptions() : projectorCount(4), projector(1280, 800), multiplexed(false), reliefAmplitude(0.0) {}
+};
+
+class Simulation {
+public:
+    explicit Simulation(const SimOptions& options) : options(options), rig(options.camera), projectors(options.projectorCount) {}
+
+    bool run() {
+        if (!prepareWorkingDirectory()) return false;
+
+        ProjectorConfig::CAMWIDTH = options.camera.size.width;
+        ProjectorConfig::CAMHEIGHT = options.camera.size.height;
+        // The virtual camera has no latency, the first unchanged frame after a pattern change is final
+        ProjectorConfig::settleParams.stableFrames = 1;
+        ProjectorConfig::setRig(&rig);
+        layoutProjectors();
+
+        auto start = std::chrono::steady_clock::now();
+        if (options.multiplexed) {
+            measure("calibrateMultiplexed", 0, [&] { ProjectorConfig::calibrateMultiplexed(projectors.data(), options.projectorCount); });
+        } else {
+            // One projector at a time, the others stay dark
+            for (int i = 0; i < options.projectorCount; i++) {
+                ProjectorConfig& projector = projectors[i];
+                for (int j = 0; j < options.projectorCount; j++)
+                    rig.showPattern(j + 1, Mat::zeros(options.projector, CV_8UC1));
+                measure("generateGraycodes", i + 1, [&] { projector.generateGraycodes(); });
+                measure("captureGraycodes", i + 1, [&] { projector.captureGraycodes(); });
+                measure("decodeGraycode", i + 1, [&] { projector.decodeGraycode(); });
+            }
+        }
+        for (int i = 0; i < options.projectorCount; i++)
+            measure("computeHomography", i + 1, [&] { projectors[i].computeHomography(); });
+        measure("computeContributions", 0, [&] { ProjectorConfig::computeContributions(projectors.data(), options.projectorCount); });
+        totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ProjectorConfig::setRig(nullptr);
+
+        for (int i = 0; i < options.projectorCount; i++)
+            accuracy.push_back(measureAccuracy(projectors[i]));
+        return true;
+    }
+
+    bool writeJSON(std::ostream& os) const {
+        os << "{\n"
+           << "  \"simulation\": \"ClimbPM_sim\",\n"
+           << "  \"opencv\": \"" << CV_VERSION << "\",\n"
+           << "  \"threads\": " << getNumThreads() << ",\n"
+           << "  \"camera\": [" << options.camera.size.width << ", " << options.camera.size.height << "],\n"
+           << "  \"projector\": [" << options.projector.width << ", " << options.projector.height << "],\n"
+           << "  \"projectors\": " << options.projectorCount << ",\n"
+           << "  \"mode\": \"" << (options.multiplexed ? "multiplexed" : "sequential") << "\",\n"
+           << "  \"noise\": " << options.camera.noiseSigma << ",\n"
+           << "  \"blur\": " << options.camera.blurSigma << ",\n"
+           << "  \"ambient\": " << options.camera.ambient << ",\n"
+           << "  \"holds\": " << options.camera.holdCount << ",\n"
+           << "  \"relief\": " << options.reliefAmplitude << ",\n"
+           << "  \"seed\": " << options.camera.seed << ",\n"
+           << "  \"totalMs\": " << totalMs << ",\n"
+           << "  \"framesCaptured\": " << rig.getFrameCount() << ",\n"
+           << "  \"framesPerSecond\": " << rig.getFrameCount() / (totalMs / 1000.0) << ",\n"
+           << "  \"projectorsPerMinute\": " << options.projectorCount / (totalMs / 60000.0) << ",\n"
+           << "  \"stages\": [\n";
+        for (size_t i = 0; i < stages.size(); i++) {
+            os << "    { \"stage\": \"" << stages[i].stage << "\", \"projector\": " << stages[i].projector
+               << ", \"ms\": " << stages[i].ms << " }" << (i + 1 < stages.size() ? "," : "") << "\n";
+        }
+        os << "  ],\n"
+           << "  \"accuracy\": [\n";
+        for (size_t i = 0; i < accuracy.size(); i++) {
+            const SimAccuracy& a = accuracy[i];
+            os << "    { \"projector\": " << a.projector
+               << ", \"truthPixels\": " << a.truthPixels
+               << ", \"coverage\": " << a.coverage
+               << ", \"falseMapped\": " << a.falseMapped
+               << ", \"c2pErrorMean\": " << a.c2pErrorMean
+               << ", \"c2pErrorMedian\": " << a.c2pErrorMedian
+               << ", \"c2pErrorP95\": " << a.c2pErrorP95
+               << ", \"homographyErrorMean\": " << a.homographyErrorMean
+               << ", \"homographyErrorP95\": " << a.homographyErrorP95 << " }"
+               << (i + 1 < accuracy.size() ? "," : "") << "\n";
+        }
+        os << "  ]\n}\n";
+        return (bool)os;
+    }
+
+private:
+    SimOptions options;
+    VirtualRig rig;
+    std::vector<ProjectorConfig> projectors;
+    std::vector<SimStage> stages;
+    std::vector<SimAccuracy> accuracy;
+    double totalMs = 0.0;
+
+    bool prepareWorkingDirectory() {
+        fs::path workingDirectory = fs::temp_directory_path() / "ClimbPM_sim";
+        std::error_code error;
+        fs::remove_all(workingDirectory, error);
+        fs::create_directories(workingDirectory, error);
+        if (error) {
+            std::cerr << "Could not create \"" << workingDirectory.string() << "\": " << error.message() << std::endl;
+            return false;
+        }
+        fs::current_path(workingDirectory);
+        std::cerr << "Simulating in \"" << workingDirectory.string() << "\"" << std::endl;
+        return true;
+    }
+
+    // Projectors tile the camera image in a grid, each one overlapping its neighbours and slightly keystoned
+    void layoutProjectors() {
+        const int cols = (int)std::ceil(std::sqrt((double)options.projectorCount));
+        const int rows = (options.projectorCount + cols - 1) / cols;
+        const double cellW = (double)options.camera.size.width / cols, cellH = (double)options.camera.size.height / rows;
+        const Point2f corners[4] = { Point2f(0, 0), Point2f(options.projector.width - 1, 0),
+                                     Point2f(options.projector.width - 1, options.projector.height - 1),
+                                     Point2f(0, options.projector.height - 1) };
+        RNG layoutRng(options.camera.seed);
+        for (int i = 0; i < options.projectorCount; i++) {
+            double left = (i % cols - SIM_OVERLAP) * cellW, right = (i % cols + 1 + SIM_OVERLAP) * cellW;
+            double top = (i / cols - SIM_OVERLAP) * cellH, bottom = (i / cols + 1 + SIM_OVERLAP) * cellH;
+            Point2f footprint[4] = { Point2f(left, top), Point2f(right, top), Point2f(right, bottom), Point2f(left, bottom) };
+            for (Point2f& corner : footprint) {
+                corner.x += (float)layoutRng.uniform(-SIM_CORNER_JITTER, SIM_CORNER_JITTER) * cellW;
+                corner.y += (float)layoutRng.uniform(-SIM_CORNER_JITTER, SIM_CORNER_JITTER) * cellH;
+            }
+            Matx33d projectorToCamera = getPerspectiveTransform(corners, footprint);
+            rig.addProjector(i + 1, options.projector, projectorToCamera, options.reliefAmplitude);
+            projectors[i] = ProjectorConfig(ProjectorParams(i + 1, options.projector.width, options.projector.height, 0, 0));
+        }
+    }
+
+    SimAccuracy measureAccuracy(ProjectorConfig& projector) {
+        SimAccuracy result{ projector.params.id, 0, 0.0, 0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+        Mat truthCoords, truthValid;
+        if (!rig.groundTruth(projector.params.id, truthCoords, truthValid) || projector.c2pMap.empty()) return result;
+
+        result.truthPixels = countNonZero(truthValid);
+        result.falseMapped = countNonZero(projector.c2pValid & ~truthValid);
+        std::vector<float> c2pErrors, homographyErrors;
+        Mat h = projector.getHomography();
+        Matx33d cameraToProjector = h.empty() ? Matx33d::eye() : Matx33d(h);
+        for (int y = 0; y < truthCoords.rows; y++) {
+            const Vec2f* truthRow = truthCoords.ptr<Vec2f>(y);
+            const uchar* truthValidRow = truthValid.ptr<uchar>(y);
+            const Vec2w* mapRow = projector.c2pMap.ptr<Vec2w>(y);
+            const uchar* validRow = projector.c2pValid.ptr<uchar>(y);
+            for (int x = 0; x < truthCoords.cols; x++) {
+                if (!truthValidRow[x]) continue;
+                if (validRow[x])
+                    c2pErrors.push_back((float)norm(Vec2f(mapRow[x][0], mapRow[x][1]) - truthRow[x]));
+                if (!h.empty() && y % SIM_HOMOGRAPHY_STEP == 0 && x % SIM_HOMOGRAPHY_STEP == 0) {
+                    Vec3d p = cameraToProjector * Vec3d(x, y, 1.0);
+                    homographyErrors.push_back((float)norm(Vec2f((float)(p[0] / p[2]), (float)(p[1] / p[2])) - truthRow[x]));
+                }
+            }
+        }
+        result.coverage = result.truthPixels > 0 ? (double)c2pErrors.size() / result.truthPixels : 0.0;
+        summarize(c2pErrors, result.c2pErrorMean, result.c2pErrorMedian, result.c2pErrorP95);
+        double homographyMedian;
+        summarize(homographyErrors, result.homographyErrorMean, homographyMedian, result.homographyErrorP95);
+        return result;
+    }
+
+    static void summarize(std::vector<float>& errors, double& mean, double& median, double& p95) {
+        mean = median = p95 = 0.0;
+        if (errors.empty()) return;
+        double sum = 0.0;
+        for (float error : errors) sum += error;
+        mean = sum / errors.size();
+        std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+        median = errors[errors.size() / 2];
+        std::nth_element(errors.begin(), errors.begin() + errors.size() * 95 / 100, errors.end());
+        p95 = errors[errors.size() * 95 / 100];
+    }
+
+    void measure(const std::string& stage, int projector, const std::function<void()>& body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << stage << (projector > 0 ? " (projector " + std::to_string(projector) + ")" : "") << ": "
+                  << ms << " ms" << std::endl;
+        stages.push_back({ stage, projector, ms });
+    }
+};
+
+static bool parseSize(const std::string& text, Size& size) {
+    int width, height;
+    if (std::sscanf(text.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) return false;
+    size = Size(width, height);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    std::string output, trace;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i], value = argv[i + 1];
+        bool valid = true;
+        if (option == "--projectors") options.projectorCount = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--projector") valid = parseSize(value, options.projector);
+        else if (option == "--camera") valid = parseSize(value, options.camera.size);
+        else if (option == "--mode") {
+            options.multiplexed = value == "multiplexed";
+            valid = options.multiplexed || value == "sequential";
+        }
+        else if (option == "--noise") options.camera.noiseSigma = std::atof(value.c_str());
+        else if (option == "--blur") options.camera.blurSigma = std::atof(value.c_str());
+        else if (option == "--ambient") options.camera.ambient = std::atof(value.c_str());
+        else if (option == "--holds") options.camera.holdCount = std::max(0, std::atoi(value.c_str()));
+        else if (option == "--relief") options.reliefAmplitude = std::atof(value.c_str());
+        else if (option == "--seed") options.camera.seed = (uint64)std::strtoull(value.c_str(), nullptr, 10);
+        else if (option == "--output") output = value;
+        else if (option == "--trace") trace = value;
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return -1;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value \"" << value << "\" for " << option << std::endl;
+            return -1;
+        }
+    }
+    // Resolved before the simulation changes into its working directory
+    if (!output.empty()) output = fs::absolute(output).string();
+    if (!trace.empty()) trace = fs::absolute(trace).string();
+
+    // Stage metrics are printed after the run, the trace shows where each projector's calibration spent its time
+    Metrics::setEnabled(true);
+    Metrics::setTracing(!trace.empty());
+
+    // Stage output goes to stderr, so stdout only holds the JSON
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    Simulation simulation(options);
+    bool success = simulation.run();
+    std::cout.rdbuf(stdoutBuffer);
+    if (!success) return -1;
+    Metrics::report(std::cerr);
+    if (!trace.empty() && !Metrics::writeTrace(trace)) return -1;
+
+    if (output.empty())
+        return simulation.writeJSON(std::cout) ? 0 : -1;
+    std::ofstream os(output);
+    if (!os.is_open() || !simulation.writeJSON(os)) {
+        std::cerr << "Could not write \"" << output << "\"!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+//
+// Plays timestamped frames (video files, live streams) on all projectors.
+//
+
+#include "VideoPlayer.h"
+
+VideoPlayer::VideoPlayer(ProjectorConfig* projectors, uint count, FrameSource& source)
+: projectors(projectors), count(count), source(source), stopping(false), finished(false) {
+    for (uint i = 0; i < count; i++)
+        channels.push_back(std::make_unique<Channel>());
+}
+
+VideoPlayer::~VideoPlayer() {
+    stop();
+}
+
+void VideoPlayer::play() {
+    // Computed up front, the warp threads must not compute it concurrently
+    for (uint i = 0; i < count; i++)
+        projectors[i].getHomography();
+
+    // Short preroll, so the first frames can be warped in time
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(PLAYBACK_LEAD_MS);
+    reader = std::thread(&VideoPlayer::readFrames, this, start);
+    for (uint i = 0; i < count; i++)
+        warpers.emplace_back(&VideoPlayer::warpFrames, this, i);
+
+    pacer = std::thread(&VideoPlayer::paceFrames, this);
+
+    // Every projector draws and swaps on its own render thread, this thread handles the window events
+    ProjectorConfig::presentContent(projectors, count, Size(), [this] { return finished.load(); });
+
+    stop();
+    printStats();
+}
+
+void VideoPlayer::paceFrames() {
+    while (!stopping) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point nextDue = now + std::chrono::milliseconds(2);
+        bool done = true;
+
+        for (uint i = 0; i < count; i++) {
+            Channel& channel = *channels[i];
+            if (!channel.hasPending)
+                channel.hasPending = channel.presentQueue.tryPop(channel.pending);
+
+            // Of all frames that are due, only the newest one is shown
+            TimedFrame frame;
+            bool hasFrame = false;
+            while (channel.hasPending && channel.pending.due <= now) {
+                if (hasFrame) channel.dropped++;
+                frame = std::move(channel.pending);
+                hasFrame = true;
+                channel.hasPending = channel.presentQueue.tryPop(channel.pending);
+            }
+
+            if (hasFrame) {
+                if (now - frame.due > std::chrono::milliseconds(PLAYBACK_LATE_MS)) channel.late++;
+                projectors[i].updateContent(frame.image, false);
+                channel.presented++;
+            }
+            if (channel.hasPending && channel.pending.due < nextDue)
+                nextDue = channel.pending.due;
+            done = done && !channel.hasPending && channel.presentQueue.isFinished();
+        }
+        if (done) break;
+
+        // Nothing to show right now
+        std::this_thread::sleep_until(nextDue);
+    }
+    // Wakes up the main thread, which returns from presenting
+    finished = true;
+    glfwPostEmptyEvent();
+}
+
+PlaybackStats VideoPlayer::getStats(uint projector) const {
+    const Channel& channel = *channels[projector];
+    PlaybackStats stats;
+    stats.presented = channel.presented;
+    stats.dropped = channel.dropped;
+    stats.late = channel.late;
+    return stats;
+}
+
+void VideoPlayer::printStats() const {
+    for (uint i = 0; i < count; i++) {
+        PlaybackStats stats = getStats(i);
+        std::cout << "Projector " << projectors[i].params.id << ": " << stats.presented << " frames presented, "
+                  << stats.dropped << " dropped, " << stats.late << " late" << std::endl;
+    }
+}
+
+void VideoPlayer::readFrames(Clock::time_point start) {
+    bool first = true;
+    double firstTimestampMs = 0.0;
+    Mat frame;
+    double timestampMs;
+    while (!stopping && source.read(frame, timestampMs)) {
+        if (first) {
+            firstTimestampMs = timestampMs;
+            first = false;
+        }
+
+        TimedFrame timed;
+        if (source.isLive()) {
+            timed.due = Clock::now();
+        } else {
+            timed.due = start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(timestampMs - firstTimestampMs));
+            // Do not read further ahead than needed for warping
+            std::unique_lock<std::mutex> lock(stopMutex);
+            stopCondition.wait_until(lock, timed.due - std::chrono::milliseconds(PLAYBACK_LEAD_MS),
+                                     [this] { return stopping.load(); });
+        }
+
+        // All projectors share the decoded frame, each warps it into its own buffers
+        for (uint i = 0; i < count; i++) {
+            TimedFrame shared{ frame, timed.due };
+            if (channels[i]->warpQueue.pushDropOldest(std::move(shared)) > 0)
+                channels[i]->dropped++;
+        }
+    }
+    for (auto& channel : channels)
+        channel->warpQueue.close();
+}
+
+void VideoPlayer::warpFrames(uint projector) {
+    Channel& channel = *channels[projector];
+    TimedFrame frame;
+    while (channel.warpQueue.pop(frame)) {
+        // Frames that are already too late to be shown are not worth warping
+        if (Clock::now() > frame.due + std::chrono::milliseconds(PLAYBACK_LATE_MS) && channel.warpQueue.size() > 0) {
+            channel.dropped++;
+            continue;
+        }
+        TimedFrame warped{ projectors[projector].warpToBuffer(frame.image), frame.due };
+        if (channel.presentQueue.pushDropOldest(std::move(warped)) > 0)
+            channel.dropped++;
+    }
+    channel.presentQueue.close();
+}
+
+void VideoPlayer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    for (auto& channel : channels) {
+        channel->warpQueue.close();
+        channel->presentQueue.close();
+    }
+    if (reader.joinable()) reader.join();
+    if (pacer.joinable()) pacer.join();
+    for (auto& warper : warpers)
+        if (warper.joinable()) warper.join();
+    warpers.clear();
+}
@@ -0,0 +1,89 @@
+//
+// Plays timestamped frames (video files, live streams) on all projectors.
+//
+
+#ifndef CLIMBPM_VIDEOPLAYER_H
+#define CLIMBPM_VIDEOPLAYER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "FrameSource.h"
+#include "ProjectorConfig.h"
+
+// Frames are read this far ahead of their presentation time (ms)
+#define PLAYBACK_LEAD_MS 50
+// Frames presented later than this after their presentation time count as late (ms)
+#define PLAYBACK_LATE_MS 8
+// Capacity of the queues between reading, warping and presenting (frames per projector)
+#define PLAYBACK_QUEUE_SIZE 3
+
+// Playback counters of one projector
+struct PlaybackStats {
+    uint64_t presented;
+    // Never shown: discarded by a full queue or replaced by a newer frame that was due as well
+    uint64_t dropped;
+    // Shown more than PLAYBACK_LATE_MS after the presentation time
+    uint64_t late;
+    PlaybackStats() : presented(0), dropped(0), late(0) {}
+};
+
+class VideoPlayer {
+public:
+    VideoPlayer(ProjectorConfig* projectors, uint count, FrameSource& source);
+    ~VideoPlayer();
+
+    // Plays until the source ends or a projector window is closed, must be called on the thread owning the windows
+    void play();
+    // Counters of the projector at index projector of the array given to the constructor
+    PlaybackStats getStats(uint projector) const;
+    void printStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct TimedFrame {
+        Mat image;
+        Clock::time_point due;
+    };
+
+    // Frames of one projector on their way from the reader to the screen
+    struct Channel {
+        BoundedQueue<TimedFrame> warpQueue;
+        BoundedQueue<TimedFrame> presentQueue;
+        std::atomic<uint64_t> dropped;
+        uint64_t presented, late;
+        // Next frame taken from presentQueue that is not due yet
+        TimedFrame pending;
+        bool hasPending;
+        Channel() : warpQueue(PLAYBACK_QUEUE_SIZE), presentQueue(PLAYBACK_QUEUE_SIZE), dropped(0),
+                    presented(0), late(0), hasPending(false) {}
+    };
+
+    ProjectorConfig* projectors;
+    uint count;
+    FrameSource& source;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::thread reader;
+    std::vector<std::thread> warpers;
+    std::thread pacer;
+    std::atomic<bool> stopping;
+    // All frames were shown
+    std::atomic<bool> finished;
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+
+    void readFrames(Clock::time_point start);
+    void warpFrames(uint projector);
+    // Hands every frame to its projector's render thread once it is due
+    void paceFrames();
+    void stop();
+};
+
+
+#endif //CLIMBPM_VIDEOPLAYER_H
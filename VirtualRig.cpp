@@ -0,0 +1,127 @@
+//
+// Simulated projectors and camera with known ground truth, used by ClimbPM_sim.
+//
+
+#include "VirtualRig.h"
+#include <cmath>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+VirtualRig::VirtualRig(const VirtualCameraParams& camera) : params(camera), rng(camera.seed), frameCount(0) {
+    // Holds are ellipses of random size and orientation scattered over the wall
+    holds = Mat::zeros(params.size, CV_8UC1);
+    for (int i = 0; i < params.holdCount; i++) {
+        Point center(rng.uniform(0, params.size.width), rng.uniform(0, params.size.height));
+        Size axes(rng.uniform(15, 40), rng.uniform(15, 40));
+        ellipse(holds, center, axes, rng.uniform(0.0, 180.0), 0.0, 360.0, Scalar(255), FILLED);
+    }
+    albedo = Mat(params.size, CV_32F, Scalar(1.0));
+    albedo.setTo(Scalar(VIRTUAL_HOLD_ALBEDO), holds);
+}
+
+void VirtualRig::addProjector(uint id, Size resolution, const Matx33d& projectorToCamera, double reliefAmplitude,
+                              double brightness) {
+    VirtualProjector projector;
+    projector.id = id;
+    projector.resolution = resolution;
+    projector.projectorToCamera = projectorToCamera;
+    projector.brightness = brightness;
+    projector.image = Mat::zeros(resolution, CV_8UC1);
+
+    // Relief and shadows shift light away from the camera center, towards where the projector's center lands
+    Vec3d center = projectorToCamera * Vec3d(resolution.width / 2.0, resolution.height / 2.0, 1.0);
+    Point2d direction(center[0] / center[2] - params.size.width / 2.0, center[1] / center[2] - params.size.height / 2.0);
+    double length = std::sqrt(direction.dot(direction));
+    direction = (length > 0.0) ? direction * (1.0 / length) : Point2d(1.0, 0.0);
+
+    Matx33d cameraToProjector = projectorToCamera.inv();
+    projector.mapX.create(params.size, CV_32F);
+    projector.mapY.create(params.size, CV_32F);
+    parallel_for_(Range(0, params.size.height), [&](const Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            float* mapXRow = projector.mapX.ptr<float>(y);
+            float* mapYRow = projector.mapY.ptr<float>(y);
+            for (int x = 0; x < params.size.width; x++) {
+                double relief = reliefAmplitude * std::sin(2.0 * CV_PI * x / VIRTUAL_RELIEF_WAVELENGTH)
+                                                * std::cos(2.0 * CV_PI * y / VIRTUAL_RELIEF_WAVELENGTH);
+                Vec3d p = cameraToProjector * Vec3d(x + relief * direction.x, y + relief * direction.y, 1.0);
+                double px = p[0] / p[2], py = p[1] / p[2];
+                bool inside = p[2] > 0.0 && px >= 0.0 && py >= 0.0 && px <= resolution.width - 1 && py <= resolution.height - 1;
+                mapXRow[x] = inside ? (float)px : -1.0f;
+                mapYRow[x] = inside ? (float)py : -1.0f;
+            }
+        }
+    });
+
+    // Holds shadow the wall next to them, but are lit themselves
+    Matx23d shift(1.0, 0.0, direction.x * VIRTUAL_HOLD_SHADOW_OFFSET, 0.0, 1.0, direction.y * VIRTUAL_HOLD_SHADOW_OFFSET);
+    warpAffine(holds, projector.shadow, shift, params.size, INTER_NEAREST, BORDER_CONSTANT, Scalar(0));
+    projector.shadow.setTo(Scalar(0), holds);
+
+    projectors.push_back(projector);
+}
+
+void VirtualRig::showPattern(uint projectorId, const Mat& image) {
+    for (VirtualProjector& projector : projectors) {
+        if (projector.id != projectorId) continue;
+        // Like a full screen window, images of other sizes are stretched over the whole projector
+        Mat gray = image;
+        if (image.channels() == 3)
+            cvtColor(image, gray, COLOR_BGR2GRAY);
+        if (gray.size() != projector.resolution)
+            resize(gray, projector.image, projector.resolution, 0, 0, INTER_NEAREST);
+        else
+            gray.copyTo(projector.image);
+        return;
+    }
+    std::cerr << "Virtual rig has no projector " << projectorId << "!" << std::endl;
+}
+
+Mat VirtualRig::captureFrame() {
+    frameCount++;
+    Mat light = Mat::zeros(params.size, CV_32F);
+    Mat sample;
+    for (const VirtualProjector& projector : projectors) {
+        remap(projector.image, sample, projector.mapX, projector.mapY, INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
+        sample.convertTo(sample, CV_32F, projector.brightness);
+        sample.setTo(Scalar(0), projector.shadow);
+        light += sample;
+    }
+    multiply(light, albedo, light);
+    light += Scalar(params.ambient);
+
+    if (params.blurSigma > 0.0)
+        GaussianBlur(light, light, Size(), params.blurSigma);
+    if (params.noiseSigma > 0.0) {
+        Mat noise(params.size, CV_32F);
+        rng.fill(noise, RNG::NORMAL, 0.0, params.noiseSigma);
+        light += noise;
+    }
+
+    Mat gray, frame;
+    light.convertTo(gray, CV_8U);
+    cvtColor(gray, frame, COLOR_GRAY2BGR);
+    return frame;
+}
+
+bool VirtualRig::groundTruth(uint projectorId, Mat& coords, Mat& valid) const {
+    const VirtualProjector* projector = find(projectorId);
+    if (projector == nullptr) return false;
+    Mat channels[2] = { projector->mapX, projector->mapY };
+    merge(channels, 2, coords);
+    valid = (projector->mapX >= 0.0f) & (projector->shadow == 0);
+    return true;
+}
+
+bool VirtualRig::groundTruthHomography(uint projectorId, Matx33d& projectorToCamera) const {
+    const VirtualProjector* projector = find(projectorId);
+    if (projector == nullptr) return false;
+    projectorToCamera = projector->projectorToCamera;
+    return true;
+}
+
+const VirtualRig::VirtualProjector* VirtualRig::find(uint projectorId) const {
+    for (const VirtualProjector& projector : projectors)
+        if (projector.id == projectorId) return &projector;
+    return nullptr;
+}
@@ -0,0 +1,80 @@
+//
+// Simulated projectors and camera with known ground truth, used by ClimbPM_sim.
+//
+
+#ifndef CLIMBPM_VIRTUALRIG_H
+#define CLIMBPM_VIRTUALRIG_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include "Rig.h"
+
+// Period of the wall relief that displaces projected pixels (camera pixels)
+#define VIRTUAL_RELIEF_WAVELENGTH 400.0
+// How far holds cast their shadow away from the projector (camera pixels)
+#define VIRTUAL_HOLD_SHADOW_OFFSET 12.0
+// Holds reflect less light than the wall
+#define VIRTUAL_HOLD_ALBEDO 0.5
+
+using namespace cv;
+
+// Appearance of the simulated camera image
+struct VirtualCameraParams {
+    Size size;
+    // Optics blur (sigma in camera pixels, 0 = sharp)
+    double blurSigma;
+    // Sensor noise (sigma in gray levels)
+    double noiseSigma;
+    // Light that reaches the wall from elsewhere (gray levels)
+    double ambient;
+    // Number of holds casting shadows on the wall
+    int holdCount;
+    uint64 seed;
+    VirtualCameraParams() : size(1920, 1080), blurSigma(1.0), noiseSigma(2.0), ambient(20.0), holdCount(0), seed(1) {}
+};
+
+class VirtualRig : public Rig {
+public:
+    explicit VirtualRig(const VirtualCameraParams& camera);
+
+    // Adds a projector whose image lands on the camera at projectorToCamera. reliefAmplitude (camera pixels) bends the
+    // wall, so that no single homography fits, brightness scales the light of a white projector pixel.
+    void addProjector(uint id, Size resolution, const Matx33d& projectorToCamera, double reliefAmplitude = 0.0,
+                      double brightness = 0.8);
+
+    void showPattern(uint projectorId, const Mat& image) override;
+    Mat captureFrame() override;
+
+    // Projector pixel lit onto every camera pixel (CV_32FC2) and where it is lit directly, without shadow (CV_8UC1)
+    bool groundTruth(uint projectorId, Mat& coords, Mat& valid) const;
+    // Homography of the flat wall the relief is applied to
+    bool groundTruthHomography(uint projectorId, Matx33d& projectorToCamera) const;
+    // Number of camera frames rendered so far
+    uint64 getFrameCount() const { return frameCount; }
+
+private:
+    struct VirtualProjector {
+        uint id;
+        Size resolution;
+        Matx33d projectorToCamera;
+        double brightness;
+        // Projector pixel per camera pixel, -1 where the projector does not reach the camera pixel
+        Mat mapX, mapY;
+        // Camera pixels the holds keep this projector's light from
+        Mat shadow;
+        // Image currently shown (CV_8UC1, projector resolution)
+        Mat image;
+    };
+
+    VirtualCameraParams params;
+    std::vector<VirtualProjector> projectors;
+    // Camera pixels covered by holds and the resulting surface albedo (CV_32F)
+    Mat holds, albedo;
+    RNG rng;
+    uint64 frameCount;
+
+    const VirtualProjector* find(uint projectorId) const;
+};
+
+
+#endif //CLIMBPM_VIRTUALRIG_H
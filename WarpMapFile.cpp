@@ -0,0 +1,107 @@
+//
+// Binary cache files of a projector's precomputed warp maps and fitted homography.
+//
+
+#include "WarpMapFile.h"
+#include "C2PFile.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+bool WarpMapFile::write(const std::string& path, const WarpMapFileHeader& header, const Mat& map1, const Mat& map2) {
+    CV_Assert(map1.type() == CV_16SC2 && map2.type() == CV_16UC1);
+    CV_Assert(map1.cols == (int)header.outputWidth && map1.rows == (int)header.outputHeight);
+    CV_Assert(map2.size() == map1.size());
+
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    os.write((const char*)&header, sizeof(header));
+    for (int y = 0; y < map1.rows; y++)
+        os.write((const char*)map1.ptr(y), (std::streamsize)map1.cols * map1.elemSize());
+    for (int y = 0; y < map2.rows; y++)
+        os.write((const char*)map2.ptr(y), (std::streamsize)map2.cols * map2.elemSize());
+    os.close();
+
+    if (!os) {
+        std::cerr << "Error writing warp map file \"" << path << "\"!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WarpMapFile::read(const std::string& path, uint64_t key, Mat& map1, Mat& map2) {
+    MappedFile file(path);
+    if (!file.isOpen() || file.size() < sizeof(WarpMapFileHeader)) return false;
+
+    WarpMapFileHeader header;
+    std::memcpy(&header, file.ptr(), sizeof(WarpMapFileHeader));
+    if (header.magic != WARP_MAP_FILE_MAGIC || header.version != WARP_MAP_FILE_VERSION || header.key != key)
+        return false;
+
+    size_t pixelCount = (size_t)header.outputWidth * header.outputHeight;
+    size_t expectedSize = sizeof(WarpMapFileHeader) + pixelCount * 2 * sizeof(int16_t) + pixelCount * sizeof(uint16_t);
+    if (file.size() != expectedSize) {
+        std::cerr << "Warp map file \"" << path << "\" has size " << file.size() << " but " << expectedSize
+                  << " bytes were expected!" << std::endl;
+        return false;
+    }
+
+    const unsigned char* map1Data = file.ptr() + sizeof(WarpMapFileHeader);
+    const unsigned char* map2Data = map1Data + pixelCount * 2 * sizeof(int16_t);
+    Mat((int)header.outputHeight, (int)header.outputWidth, CV_16SC2, (void*)map1Data).copyTo(map1);
+    Mat((int)header.outputHeight, (int)header.outputWidth, CV_16UC1, (void*)map2Data).copyTo(map2);
+    return true;
+}
+
+bool WarpMapFile::writeHomography(const std::string& path, uint64_t key, const Mat& homography) {
+    CV_Assert(homography.rows == 3 && homography.cols == 3);
+    HomographyFileHeader header;
+    header.key = key;
+    Mat stored(3, 3, CV_64F, header.homography);
+    homography.convertTo(stored, CV_64F);
+
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    if (!os.is_open()) {
+        std::cerr << "Could not open \"" << path << "\" for writing!" << std::endl;
+        return false;
+    }
+    os.write((const char*)&header, sizeof(header));
+    os.close();
+    if (!os) {
+        std::cerr << "Error writing homography file \"" << path << "\"!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WarpMapFile::readHomography(const std::string& path, uint64_t key, Mat& homography) {
+    std::ifstream is(path, std::ios::binary);
+    HomographyFileHeader header;
+    if (!is.is_open() || !is.read((char*)&header, sizeof(header))) return false;
+    if (header.magic != HOMOGRAPHY_FILE_MAGIC || header.version != HOMOGRAPHY_FILE_VERSION || header.key != key)
+        return false;
+    Mat(3, 3, CV_64F, header.homography).copyTo(homography);
+    return true;
+}
+
+uint64_t WarpMapFile::hash(const void* data, size_t length, uint64_t hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t WarpMapFile::hash(const Mat& mat, uint64_t hash) {
+    int dims[2] = { mat.rows, mat.cols };
+    int type = mat.type();
+    hash = WarpMapFile::hash(dims, sizeof(dims), hash);
+    hash = WarpMapFile::hash(&type, sizeof(type), hash);
+    for (int y = 0; y < mat.rows; y++)
+        hash = WarpMapFile::hash(mat.ptr(y), mat.cols * mat.elemSize(), hash);
+    return hash;
+}
@@ -0,0 +1,64 @@
+//
+// Binary cache files of a projector's precomputed warp maps and fitted homography.
+//
+
+#ifndef CLIMBPM_WARPMAPFILE_H
+#define CLIMBPM_WARPMAPFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <opencv2/core.hpp>
+
+#define WARP_MAP_FILE_MAGIC 0x50414d57u // "WMAP"
+#define WARP_MAP_FILE_VERSION 3
+#define HOMOGRAPHY_FILE_MAGIC 0x52474d48u // "HMGR"
+#define HOMOGRAPHY_FILE_VERSION 1
+
+using namespace cv;
+
+// Fixed size header at the start of every warpmap_<mode>_<width>x<height>.bin file.
+// It is followed by the fixed-point maps of cv::convertMaps() (CV_16SC2, then CV_16UC1, row-major).
+struct WarpMapFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Hash of everything the maps were computed from (calibration, warp mode, sizes)
+    uint64_t key;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t outputWidth;
+    uint32_t outputHeight;
+    WarpMapFileHeader(uint64_t key, uint32_t srcW, uint32_t srcH, uint32_t outW, uint32_t outH)
+    : magic(WARP_MAP_FILE_MAGIC), version(WARP_MAP_FILE_VERSION), key(key), sourceWidth(srcW), sourceHeight(srcH),
+      outputWidth(outW), outputHeight(outH) { }
+    WarpMapFileHeader() : WarpMapFileHeader(0, 0, 0, 0, 0) {}
+};
+
+// Content of a homography.bin file, kept apart from the warp maps so that no map file replaces it
+struct HomographyFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Hash of what the homography was fitted from (C2P map, fit parameters)
+    uint64_t key;
+    // Camera-to-projector homography, row-major
+    double homography[9];
+    HomographyFileHeader() : magic(HOMOGRAPHY_FILE_MAGIC), version(HOMOGRAPHY_FILE_VERSION), key(0), homography{} {}
+};
+
+class WarpMapFile {
+public:
+    static bool write(const std::string& path, const WarpMapFileHeader& header, const Mat& map1, const Mat& map2);
+    // Only succeeds if the file exists and was written for key, so outdated caches are ignored
+    static bool read(const std::string& path, uint64_t key, Mat& map1, Mat& map2);
+    static bool writeHomography(const std::string& path, uint64_t key, const Mat& homography);
+    // Only succeeds if the file exists and the homography was fitted from what key identifies
+    static bool readHomography(const std::string& path, uint64_t key, Mat& homography);
+
+    // 64 bit FNV-1a hash of data, continuing from hash
+    static uint64_t hash(const void* data, size_t length, uint64_t hash = 0xcbf29ce484222325ull);
+    // Hash of the content of mat (also non-continuous ones)
+    static uint64_t hash(const Mat& mat, uint64_t hash = 0xcbf29ce484222325ull);
+};
+
+
+#endif //CLIMBPM_WARPMAPFILE_H
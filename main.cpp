@@ -1,4 +1,6 @@
 #include "ProjectorConfig.h"
+#include "VideoPlayer.h"
+#include "ShadowCompensator.h"
 
 int main()
 {
@@ -10,6 +12,10 @@ int main()
     // Only needed for calibration
     //ProjectorConfig::initCamera();
 
+    // Time every stage per projector (reported below), tracing also keeps each timed call for chrome://tracing
+    //Metrics::setEnabled(true);
+    //Metrics::setTracing(true);
+
     const int PROJECTORCOUNT = 3;
     ProjectorConfig* projectors = new ProjectorConfig[PROJECTORCOUNT];
 
@@ -18,6 +24,11 @@ int main()
     projectors[1] = ProjectorConfig(2, projectors);
     projectors[2] = ProjectorConfig(3, projectors); // Homography not found
 
+    // -------------- MULTIPLEXED CALIBRATION -------------------
+    // Alternative to calibrating one projector after another below:
+    // projectors whose footprints do not overlap share one graycode sequence
+    //ProjectorConfig::calibrateMultiplexed(projectors, PROJECTORCOUNT);
+
     // Calibrate/load projector configurations
     for (int i = 0; i < PROJECTORCOUNT; i++) {
 
@@ -29,6 +40,9 @@ int main()
         // Apply optional area masking to help with overexposed projector 3
         if (i == 2)
             projectors[i].applyAreaMask();
+        // No homography fits projector 3's small area, warp it with the per-pixel lookup table instead
+        //if (i == 2)
+        //    projectors[i].setWarpMode(WARP_REMAP);
         continue;
 
         // -------------- CALIBRATE NEW CONFIGURATION ----------------
@@ -52,11 +66,35 @@ int main()
         std::cout << " Calibration finished." << std::endl;
     }
 
+    // -------------- DRIFT CORRECTION -------------------
+    // After the camera or a projector got bumped: corrects the loaded configurations with one marker image per
+    // projector, only projectors that moved too much are calibrated again
+    //ProjectorConfig::correctDrift(projectors, PROJECTORCOUNT);
+
+    // Blend overlapping projectors, the weights are applied while drawing
+    //ProjectorConfig::computeContributions(projectors, PROJECTORCOUNT);
+
     // Close windows opened while calibrating
     destroyAllWindows();
 
     auto testImg = imread("../Resources/test-image.jpg");
+
+    // -------------- SHADOW COMPENSATION -------------------
+    // Needs the contributions above and the camera: where a climber blocks a projector, the others fill in
+    //ShadowCompensator shadows(projectors, PROJECTORCOUNT);
+    //shadows.setContent(testImg);
+    //shadows.start();
+
     ProjectorConfig::projectImage(projectors, PROJECTORCOUNT, testImg);
+    //shadows.stop();
+
+    // -------------- VIDEO PLAYBACK -------------------
+    // Alternative to the still image: play a video file (or a live stream) on all projectors
+    //VideoCaptureSource video("../Resources/test-video.mp4");
+    //VideoPlayer(projectors, PROJECTORCOUNT, video).play();
+
+    //Metrics::report(std::cout);
+    //Metrics::writeTrace("trace.json");
 
     delete [] projectors;
 